@@ -0,0 +1,122 @@
+/* bar segments.
+ *
+ * drawbar() lays the bar out as segments: status blocks, tags, the layout
+ * symbol, launchers, one slot per title and the empty rest.  each segment
+ * remembers where it was and a key hashed from what it showed.  a segment
+ * at the same place with the same key is still on the bar window and is
+ * neither drawn nor copied, only the spans that changed are copied from
+ * the drawable.  buttonpress() and motionnotify() look the pointer up in
+ * the same table instead of measuring the bar again.
+ *
+ * included from dwm.c.
+ */
+
+#define BAR_SPANS 32
+
+static int barspanx[BAR_SPANS], barspanw[BAR_SPANS], nbarspans;
+static int barcopied; /* spans were copied during this drawbar() */
+static unsigned long barsegsdrawn, barsegskept;
+
+/* forgets what is on the bar, the next drawbar() draws all of it */
+void
+barinvalidate(Monitor *m)
+{
+	m->nbarsegs = 0;
+}
+
+/* copies the spans so far to the bar window */
+static void
+barcopy(Monitor *m)
+{
+	int i;
+
+	drw_flush(drw);
+	for (i = 0; i < nbarspans; i++)
+		XCopyArea(dpy, drw->drawable, m->barwin, drw->gc,
+			barspanx[i], 0, barspanw[i], bh, barspanx[i], 0);
+	barcopied = nbarspans > 0;
+	nbarspans = 0;
+}
+
+static void
+bardamage(Monitor *m, int x, int w)
+{
+	if (w <= 0)
+		return;
+	if (nbarspans && barspanx[nbarspans - 1] + barspanw[nbarspans - 1] == x) {
+		barspanw[nbarspans - 1] += w;
+		return;
+	}
+	/* the segments between spans were not drawn again and the drawable
+	 * may hold anything there, the spans so far have been drawn already */
+	if (nbarspans == BAR_SPANS)
+		barcopy(m);
+	barspanx[nbarspans] = x;
+	barspanw[nbarspans] = w;
+	nbarspans++;
+}
+
+void
+barbegin(Monitor *m, int w)
+{
+	if (w != m->barw)
+		barinvalidate(m);
+	m->barw = w;
+	m->barsegi = 0;
+	nbarspans = 0;
+	barcopied = 0;
+}
+
+/* records the next segment, returns 1 if it has to be drawn */
+int
+barseg(Monitor *m, int kind, int index, Client *c, int x, int w, unsigned long key)
+{
+	BarSeg *s;
+	int i = m->barsegi++;
+
+	if (i == m->barsegcap) {
+		m->barsegcap = m->barsegcap ? m->barsegcap * 2 : 32;
+		if (!(m->barsegs = realloc(m->barsegs, m->barsegcap * sizeof(BarSeg))))
+			die("fatal: could not realloc() bar segments:");
+	}
+	s = &m->barsegs[i];
+	if (i < m->nbarsegs && s->kind == kind && s->index == index && s->c == c
+	&& s->x == x && s->w == w && s->key == key) {
+		barsegskept++;
+		return 0;
+	}
+	s->kind = kind;
+	s->index = index;
+	s->c = c;
+	s->x = x;
+	s->w = w;
+	s->key = key;
+	bardamage(m, x, w);
+	barsegsdrawn++;
+	return 1;
+}
+
+/* copies what changed to the bar window */
+void
+barend(Monitor *m)
+{
+	m->nbarsegs = m->barsegi;
+	if (nbarspans)
+		barcopy(m);
+	if (barcopied) {
+		XSync(dpy, False);
+		roundtrips++;
+	}
+}
+
+/* the segment under x, NULL over nothing */
+BarSeg *
+barsegat(Monitor *m, int x)
+{
+	int i;
+
+	for (i = 0; i < m->nbarsegs; i++)
+		if (x >= m->barsegs[i].x && x < m->barsegs[i].x + m->barsegs[i].w)
+			return &m->barsegs[i];
+	return NULL;
+}
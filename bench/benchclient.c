@@ -0,0 +1,73 @@
+/* benchclient: maps n windows with a title, a class, an icon and some
+ * contents for bench/switcher.sh, then waits until it is killed.
+ *
+ * usage: benchclient n [first]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define ICON 48
+
+int
+main(int argc, char *argv[])
+{
+	Display *dpy;
+	Window win;
+	XClassHint ch;
+	XEvent ev;
+	GC gc;
+	Atom neticon, netname, utf8;
+	unsigned long *icon, color;
+	char name[64], class[32];
+	int i, j, n, first, scr;
+
+	if (argc < 2 || (n = atoi(argv[1])) <= 0) {
+		fputs("usage: benchclient n [first]\n", stderr);
+		return 1;
+	}
+	first = argc > 2 ? atoi(argv[2]) : 0;
+	if (!(dpy = XOpenDisplay(NULL))) {
+		fputs("benchclient: cannot open display\n", stderr);
+		return 1;
+	}
+	scr = DefaultScreen(dpy);
+	neticon = XInternAtom(dpy, "_NET_WM_ICON", False);
+	netname = XInternAtom(dpy, "_NET_WM_NAME", False);
+	utf8 = XInternAtom(dpy, "UTF8_STRING", False);
+	icon = malloc(sizeof(unsigned long) * (2 + ICON * ICON));
+	for (i = first; i < first + n; i++) {
+		/* a different colour per window, so the icon cache sees n icons */
+		color = 0xff000000 | (i * 2654435761UL & 0xffffff);
+		win = XCreateSimpleWindow(dpy, RootWindow(dpy, scr), 0, 0, 640, 480, 0,
+			BlackPixel(dpy, scr), color & 0xffffff);
+		snprintf(name, sizeof(name), "bench client %d - a title of some length", i);
+		snprintf(class, sizeof(class), "bench%d", i % 16);
+		XStoreName(dpy, win, name);
+		XChangeProperty(dpy, win, netname, utf8, 8, PropModeReplace,
+			(unsigned char *)name, strlen(name));
+		ch.res_name = class;
+		ch.res_class = class;
+		XSetClassHint(dpy, win, &ch);
+		icon[0] = icon[1] = ICON;
+		for (j = 0; j < ICON * ICON; j++)
+			icon[2 + j] = (j / ICON + j % ICON) & 8 ? color : 0xffffffff;
+		XChangeProperty(dpy, win, neticon, XA_CARDINAL, 32, PropModeReplace,
+			(unsigned char *)icon, 2 + ICON * ICON);
+		XSelectInput(dpy, win, ExposureMask);
+		XMapWindow(dpy, win);
+	}
+	free(icon);
+	gc = XCreateGC(dpy, RootWindow(dpy, scr), 0, NULL);
+	XSetForeground(dpy, gc, WhitePixel(dpy, scr));
+	for (;;) {
+		XNextEvent(dpy, &ev);
+		/* something for the previews to show */
+		if (ev.type == Expose && !ev.xexpose.count)
+			for (i = 0; i < 8; i++)
+				XFillRectangle(dpy, ev.xexpose.window, gc, 20, 20 + i * 40, 400 - i * 40, 16);
+	}
+}
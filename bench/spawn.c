@@ -0,0 +1,128 @@
+/* spawn: time from asking for a command to its exec, with fork() as dwm
+ * did and with posix_spawn() as spawn.c does, from a process holding mb
+ * megabytes of touched memory like a long running dwm.
+ *
+ * the child inherits the write end of a close-on-exec pipe, so the read
+ * end sees eof the moment it execs.
+ *
+ * usage: spawn [mb [rounds [command]]]   (default 256 200 /bin/true)
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static unsigned long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static pid_t
+viafork(char *argv[])
+{
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		setsid();
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	return pid;
+}
+
+static pid_t
+viaspawn(char *argv[])
+{
+	posix_spawnattr_t attr;
+	pid_t pid;
+
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+	if (posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ))
+		pid = -1;
+	posix_spawnattr_destroy(&attr);
+	return pid;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+run(const char *name, pid_t (*fn)(char *[]), char *argv[], int rounds)
+{
+	unsigned long long *t, start;
+	int i, fds[2];
+	pid_t pid;
+	char c;
+
+	if (!(t = calloc(rounds, sizeof(*t)))) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < rounds; i++) {
+		if (pipe(fds) < 0) {
+			perror("pipe");
+			exit(1);
+		}
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		start = now();
+		if ((pid = fn(argv)) < 0) {
+			fprintf(stderr, "%s: %s failed\n", name, argv[0]);
+			exit(1);
+		}
+		close(fds[1]);
+		while (read(fds[0], &c, 1) < 0 && errno == EINTR);
+		t[i] = now() - start;
+		close(fds[0]);
+		waitpid(pid, NULL, 0);
+	}
+	qsort(t, rounds, sizeof(*t), cmp);
+	printf("%-12s rounds %5d  p50 %7llu us  p99 %7llu us  max %7llu us\n", name, rounds,
+		t[rounds / 2] / 1000, t[rounds * 99 / 100] / 1000, t[rounds - 1] / 1000);
+	free(t);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char *cmd[] = { "/bin/true", NULL };
+	size_t mb = 256, i;
+	int rounds = 200;
+	char *mem = NULL;
+
+	if (argc > 1)
+		mb = strtoul(argv[1], NULL, 10);
+	if (argc > 2 && (rounds = atoi(argv[2])) <= 0)
+		rounds = 1;
+	if (argc > 3)
+		cmd[0] = argv[3];
+	/* resident and dirty, so fork has page tables to copy */
+	if (mb && !(mem = malloc(mb << 20))) {
+		perror("malloc");
+		return 1;
+	}
+	for (i = 0; i < (mb << 20); i += 4096)
+		mem[i] = i;
+	printf("%zu MB resident, %s\n", mb, cmd[0]);
+	run("fork", viafork, cmd, rounds);
+	run("posix_spawn", viaspawn, cmd, rounds);
+	return 0;
+}
@@ -0,0 +1,107 @@
+#!/bin/sh
+# switcher frame times under Xvfb.
+#
+# starts dwm on a private Xvfb with Composite, maps N benchclient windows
+# spread over the tags, then opens the tag switcher, moves the selection
+# around and closes it through ipc, first without and then with previews,
+# and prints p50/p99 per frame from get_stats.  run from the source tree
+# after make.  the bench dwm and dwm-msg use a socket of their own
+# (DWM_SOCKET), so a running dwm is left alone.
+#
+# usage: bench/switcher.sh [clients...]   (default 10 50 200)
+
+cd "$(dirname "$0")/.." || exit 1
+[ $# -gt 0 ] || set -- 10 50 200
+DISP=${BENCHDISPLAY:-:97}
+ROUNDS=${ROUNDS:-20}
+MOVES=${MOVES:-10}
+TAGS=9
+DWM_SOCKET=$(mktemp -u "${TMPDIR:-/tmp}/dwm-bench.XXXXXX") || exit 1
+export DWM_SOCKET
+
+msg() { ./dwm-msg run_command "$@" >/dev/null; }
+
+# never talk to anything but the dwm started here
+alive() {
+	if ! kill -0 "$1" 2>/dev/null; then
+		echo "bench: $2 did not start" >&2
+		kill $xvfb 2>/dev/null
+		exit 1
+	fi
+}
+
+frames() {
+	./dwm-msg get_stats | python3 -c '
+import json, sys
+f = json.load(sys.stdin)["switcher_frames"]
+for mode in ("plain", "preview"):
+    s = f[mode]
+    print("%6s %-8s frames %5d  p50 %7d us  p99 %7d us  max %7d us"
+          % (sys.argv[1], mode, s["frames"], s["p50_us"], s["p99_us"], s["max_us"]))
+' "$1"
+}
+
+drive() {
+	r=0
+	while [ $r -lt "$ROUNDS" ]; do
+		msg toggleswitchers
+		m=0
+		while [ $m -lt "$MOVES" ]; do
+			# right, down, left, up, so the selection walks around
+			case $((m % 4)) in
+			0) msg switchermove 1 ;;
+			1) msg switchermove -2 ;;
+			2) msg switchermove -1 ;;
+			3) msg switchermove 2 ;;
+			esac
+			m=$((m + 1))
+		done
+		msg toggleswitchers
+		r=$((r + 1))
+	done
+}
+
+for n in "$@"; do
+	Xvfb "$DISP" -screen 0 1920x1080x24 +extension Composite -nolisten tcp >/dev/null 2>&1 &
+	xvfb=$!
+	sleep 1
+	alive $xvfb Xvfb
+	DISPLAY=$DISP DWM_FRAMESYNC=1 ./dwm >/dev/null 2>&1 &
+	dwm=$!
+	sleep 1
+	alive $dwm dwm
+	if [ ! -S "$DWM_SOCKET" ]; then
+		echo "bench: dwm has no socket at $DWM_SOCKET" >&2
+		kill $dwm $xvfb 2>/dev/null
+		exit 1
+	fi
+
+	per=$(( (n + TAGS - 1) / TAGS ))
+	t=0
+	made=0
+	pids=
+	while [ $made -lt "$n" ]; do
+		k=$per
+		[ $((made + k)) -gt "$n" ] && k=$((n - made))
+		msg view $((1 << t))
+		DISPLAY=$DISP bench/benchclient $k $made &
+		pids="$pids $!"
+		sleep 0.5
+		made=$((made + k))
+		t=$(( (t + 1) % TAGS ))
+	done
+	msg view 1
+
+	# once in each mode, frames are kept apart by whether they had previews
+	drive
+	msg toggleswitcherpreview
+	drive
+	frames "$n"
+
+	kill $pids 2>/dev/null
+	msg quit
+	wait $dwm 2>/dev/null
+	kill $xvfb
+	wait $xvfb 2>/dev/null
+	rm -f "$DWM_SOCKET"
+done
@@ -8,7 +8,10 @@
 #define ICONSIZE 16
 #define ICONSPACING 5
 static const unsigned int isscratchmask  = 0;        /* hide other clients when scratch shown */
-static const unsigned int isswitcherpreview  = 1;        /* switch preview */
+static unsigned int isswitcherpreview  = 1;        /* switch preview, toggleswitcherpreview flips it */
+static const unsigned long previewbudget = 256UL << 20; /* bytes of window pixmaps kept redirected for previews */
+static const int thumbsize               = 256;      /* longest side of thumbnails read back from unmapped windows */
+static const int unmaphidden             = 0;        /* 1 means unmap windows on hidden tags (IconicState) instead of moving them off screen */
 static const unsigned int borderpx  = 2;        /* border pixel of windows */
 static const Gap default_gap        = {.isgap = 1, .realgap = 10, .gappx = 15};
 static const unsigned int snap      = 32;       /* snap pixel */
@@ -146,6 +149,15 @@ static const int nmaster     = 1;    /* number of clients in master area (没什
 static const int resizehints = 1;    /* 1 means respect size hints in tiled resizals */
 static const int lockfullscreen = 1; /* 1 will force focus on the fullscreen window */
 static const int expandslavewhenfocus = 0; // focus slave窗口时, 是否扩展当前窗口
+/* tile7 placement: NULL uses the built-in engine, otherwise the base url of
+ * smartwinserver.py, asked without blocking and given up on after placementtimeout ms */
+static const char *placementurl = NULL; /* e.g. "http://localhost:8666" */
+static const long placementtimeout = 200;
+
+/* trace categories kept in the in-memory trace (dwm-msg dump_trace), the rest
+ * compile to a test and a return */
+static const unsigned int tracecategories = 1 << TraceLog | 1 << TraceX
+	| 1 << TraceArrange | 1 << TraceDraw | 1 << TracePlacement;
 
 /* Include */
 #include "sort.c"
@@ -179,8 +191,21 @@ static const Layout layouts[] = {
 /* helper for spawning shell commands in the pre dwm-5.0 fashion */
 #define SHCMD(cmd) { .v = (const char*[]){ "/bin/sh", "-c", cmd, NULL } }
 
+/* 1: fork() dwm for every command instead of posix_spawn(), see spawn.c */
+static const int spawnfork = 0;
+
 #define STATUSBAR "dwmblocks"
 
+/* status blocks dwm updates itself instead of reading the root window name, see status.c */
+static const int usestatusblocks = 0;
+static const char statusdelim[] = " | ";
+static const StatusBlock statusblocks[] = {
+	/* source      arg                                             interval (s), 0: on click only */
+	{ StatusCmd,   "free -h | awk '/^Mem/ { print $3 \"/\" $2 }'",  30 },
+	{ StatusFile,  "/sys/class/power_supply/BAT0/capacity",          60 },
+	{ StatusTime,  "%a %d %b %H:%M",                                 60 },
+};
+
 /* commands */
 static char dmenumon[2] = "0"; /* component of dmenucmd, manipulated in spawn() */
 static const char *dmenucmd[] = { "dmenu_run", "-m", dmenumon, "-fn", dmenufont, "-nb", col_gray1, "-nf", col_gray3, "-sb", col_cyan, "-sf", col_gray4, "-l", "10", NULL };
@@ -721,6 +746,9 @@ static IPCCommand ipccommands[] = {
   IPCCOMMAND(  nextsidecar,         1,      {ARG_TYPE_NONE}    ),
   IPCCOMMAND(  nextmanagetype,         1,      {ARG_TYPE_UINT}    ),
   IPCCOMMAND(  container_layout_tile_v_movesplit_toggle,         1,      {ARG_TYPE_SINT}    ),
+  IPCCOMMAND(  toggleswitchers,     1,      {ARG_TYPE_NONE}   ),
+  IPCCOMMAND(  switchermove,        1,      {ARG_TYPE_SINT}   ),
+  IPCCOMMAND(  toggleswitcherpreview, 1,    {ARG_TYPE_NONE}   ),
 //   IPCCOMMAND(  setcontainerlayout,  1,      {ARG_TYPE_PTR}    ),
   IPCCOMMAND(  quit,                1,      {ARG_TYPE_NONE}   )
 };
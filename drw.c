@@ -16,6 +16,54 @@
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
 
+unsigned long roundtrips; /* see drw.h */
+
+/* text widths.  measuring a string runs every character through
+ * XftCharExists and the font fallback, and the bar measures the same few
+ * strings on every redraw and pointer event.  printable ASCII the first
+ * font has is summed from its advance table, everything else is looked up
+ * in a small LRU cache keyed by the fontset and the string. */
+#define TEXTCACHE_SIZE    256
+#define TEXTCACHE_BUCKETS 512
+#define TEXTCACHE_LEN     128 /* longer strings are measured every time */
+
+typedef struct TextExt TextExt;
+struct TextExt {
+	Fnt *set;
+	unsigned long hash;
+	unsigned int w;
+	TextExt *hnext;       /* bucket chain */
+	TextExt *prev, *next; /* lru, most recent first */
+	char text[TEXTCACHE_LEN];
+};
+
+/* which font draws a codepoint.  walking the fontset with XftCharExists
+ * for every character, and fontconfig matching for those no font has, is
+ * done once per codepoint and remembered, including the codepoints nothing
+ * matched.  at most FALLBACK_MAX fonts are appended to the fontset by the
+ * matching, later misses are drawn with the first font */
+#define GLYPHCACHE_SIZE 4096 /* power of two */
+#define FALLBACK_MAX    16
+
+typedef struct {
+	Fnt *set;
+	long cp;
+	Fnt *font;
+} GlyphFont;
+
+static GlyphFont glyphfonts[GLYPHCACHE_SIZE];
+static size_t glyphused;
+static int fallbacks;
+static unsigned long glyphhits, glyphlookups, glyphnomatch;
+
+enum { BatchFill, BatchOutline, BatchLine }; /* Drw.batch.kind */
+
+static TextExt textexts[TEXTCACHE_SIZE];
+static TextExt *textbuckets[TEXTCACHE_BUCKETS];
+static TextExt textlru = { .prev = &textlru, .next = &textlru };
+static size_t textused;
+static unsigned long textascii, texthits, textmisses;
+
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
 static const long utfmin[UTF_SIZ + 1] = {       0,    0,  0x80,  0x800,  0x10000};
@@ -77,6 +125,8 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->h = h;
 	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
 	drw->picture = XRenderCreatePicture(dpy, drw->drawable, XRenderFindVisualFormat(dpy, DefaultVisual(dpy, screen)), 0, NULL);
+	drw->xftdraw = XftDrawCreate(dpy, drw->drawable, DefaultVisual(dpy, screen),
+	                             DefaultColormap(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
@@ -89,6 +139,7 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 	if (!drw)
 		return;
 
+	drw_flush(drw);
 	drw->w = w;
 	drw->h = h;
 	if (drw->picture)
@@ -96,11 +147,16 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 	if (drw->drawable)
 		XFreePixmap(drw->dpy, drw->drawable);
 	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	drw->picture = XRenderCreatePicture(drw->dpy, drw->drawable,
+		XRenderFindVisualFormat(drw->dpy, DefaultVisual(drw->dpy, drw->screen)), 0, NULL);
+	XftDrawChange(drw->xftdraw, drw->drawable);
 }
 
 void
 drw_free(Drw *drw)
 {
+	drw_flush(drw);
+	XftDrawDestroy(drw->xftdraw);
 	XRenderFreePicture(drw->dpy, drw->picture);
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
@@ -152,6 +208,45 @@ drw_blur_picture(Drw *drw, Picture pic, unsigned int srcw, unsigned int srch, un
 }
 
 
+/* uploads premultiplied ARGB pixels to x, y of a 32 bit pixmap */
+void
+drw_pixmap_put_argb(Drw *drw, Pixmap pm, char *src, int x, int y, unsigned int w, unsigned int h) {
+	GC gc;
+	XImage img = {
+		w, h, 0, ZPixmap, src,
+		ImageByteOrder(drw->dpy), BitmapUnit(drw->dpy), BitmapBitOrder(drw->dpy), 32,
+		32, 0, 32,
+		0, 0, 0
+	};
+	XInitImage(&img);
+
+	gc = XCreateGC(drw->dpy, pm, 0, NULL);
+	XPutImage(drw->dpy, pm, gc, &img, 0, 0, x, y, w, h);
+	XFreeGC(drw->dpy, gc);
+}
+
+/* uploads premultiplied ARGB pixels into a new 32 bit pixmap */
+Pixmap
+drw_pixmap_create_argb(Drw *drw, char *src, unsigned int w, unsigned int h) {
+	Pixmap pm;
+
+	pm = XCreatePixmap(drw->dpy, drw->root, w, h, 32);
+	drw_pixmap_put_argb(drw, pm, src, 0, 0, w, h);
+	return pm;
+}
+
+/* a picture showing the srcw x srch pixmap at dstw x dsth, several can share
+ * one pixmap.  the pixmap may be freed afterwards */
+Picture
+drw_picture_create_scaled(Drw *drw, Pixmap pm, unsigned int srcw, unsigned int srch, unsigned int dstw, unsigned int dsth) {
+	Picture pic;
+
+	pic = XRenderCreatePicture(drw->dpy, pm, XRenderFindStandardFormat(drw->dpy, PictStandardARGB32), 0, NULL);
+	if (srcw != dstw || srch != dsth)
+		drw_resize_picture(drw, pic, srcw, srch, dstw, dsth);
+	return pic;
+}
+
 Picture
 drw_picture_create_resized(Drw *drw, char *src, unsigned int srcw, unsigned int srch, unsigned int dstw, unsigned int dsth) {
 	Pixmap pm;
@@ -159,28 +254,9 @@ drw_picture_create_resized(Drw *drw, char *src, unsigned int srcw, unsigned int
 	GC gc;
 
 	if (srcw <= (dstw << 1u) && srch <= (dsth << 1u)) {
-		XImage img = {
-			srcw, srch, 0, ZPixmap, src,
-			ImageByteOrder(drw->dpy), BitmapUnit(drw->dpy), BitmapBitOrder(drw->dpy), 32,
-			32, 0, 32,
-			0, 0, 0
-		};
-		XInitImage(&img);
-
-		pm = XCreatePixmap(drw->dpy, drw->root, srcw, srch, 32);
-		gc = XCreateGC(drw->dpy, pm, 0, NULL);
-		XPutImage(drw->dpy, pm, gc, &img, 0, 0, 0, 0, srcw, srch);
-		XFreeGC(drw->dpy, gc);
-
-		pic = XRenderCreatePicture(drw->dpy, pm, XRenderFindStandardFormat(drw->dpy, PictStandardARGB32), 0, NULL);
+		pm = drw_pixmap_create_argb(drw, src, srcw, srch);
+		pic = drw_picture_create_scaled(drw, pm, srcw, srch, dstw, dsth);
 		XFreePixmap(drw->dpy, pm);
-
-		XRenderSetPictureFilter(drw->dpy, pic, FilterBilinear, NULL, 0);
-		XTransform xf;
-		xf.matrix[0][0] = (srcw << 16u) / dstw; xf.matrix[0][1] = 0; xf.matrix[0][2] = 0;
-		xf.matrix[1][0] = 0; xf.matrix[1][1] = (srch << 16u) / dsth; xf.matrix[1][2] = 0;
-		xf.matrix[2][0] = 0; xf.matrix[2][1] = 0; xf.matrix[2][2] = 65536;
-		XRenderSetPictureTransform(drw->dpy, pic, &xf);
 	} else {
 		Imlib_Image origin = imlib_create_image_using_data(srcw, srch, (DATA32 *)src);
 		if (!origin) return None;
@@ -253,10 +329,18 @@ drw_picture_load_resized(Drw *drw, char *file, unsigned int srcw, unsigned int s
 
 void
 drw_pic(Drw *drw, int x, int y, unsigned int w, unsigned int h, Picture pic)
+{
+	drw_pic_part(drw, x, y, w, h, pic, 0, 0);
+}
+
+/* the w x h area at sx, sy of pic, e.g. one icon of an atlas */
+void
+drw_pic_part(Drw *drw, int x, int y, unsigned int w, unsigned int h, Picture pic, int sx, int sy)
 {
 	if (!drw)
 		return;
-	XRenderComposite(drw->dpy, PictOpOver, pic, None, drw->picture, 0, 0, 0, 0, x, y, w, h);
+	drw_flush(drw);
+	XRenderComposite(drw->dpy, PictOpOver, pic, None, drw->picture, sx, sy, 0, 0, x, y, w, h);
 }
 
 /* This function is an implementation detail. Library users should use
@@ -331,9 +415,21 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 	return (drw->fonts = ret);
 }
 
+static void
+textcacheclear(void)
+{
+	memset(textbuckets, 0, sizeof(textbuckets));
+	textlru.prev = textlru.next = &textlru;
+	textused = 0;
+	memset(glyphfonts, 0, sizeof(glyphfonts));
+	glyphused = 0;
+	fallbacks = 0;
+}
+
 void
 drw_fontset_free(Fnt *font)
 {
+	textcacheclear();
 	if (font) {
 		drw_fontset_free(font->next);
 		xfont_free(font);
@@ -413,25 +509,178 @@ drw_setscheme(Drw *drw, Clr *scm)
 		drw->scheme = scm;
 }
 
+/* drw_rect and drw_line calls in a row with the same kind and colour go
+ * out as one request.  everything else that draws on drw->drawable, here
+ * or by the caller, flushes them first, so the stacking order stays what
+ * the calls asked for */
+void
+drw_flush(Drw *drw)
+{
+	if (!drw || !drw->batch.n)
+		return;
+	XSetForeground(drw->dpy, drw->gc, drw->batch.pixel);
+	switch (drw->batch.kind) {
+	case BatchFill:
+		XFillRectangles(drw->dpy, drw->drawable, drw->gc, drw->batch.rects, drw->batch.n);
+		break;
+	case BatchOutline:
+		XDrawRectangles(drw->dpy, drw->drawable, drw->gc, drw->batch.rects, drw->batch.n);
+		break;
+	case BatchLine:
+		XDrawSegments(drw->dpy, drw->drawable, drw->gc, drw->batch.segs, drw->batch.n);
+		break;
+	}
+	drw->batch.n = 0;
+}
+
+static void
+batch(Drw *drw, int kind, unsigned long pixel)
+{
+	if (drw->batch.n && (drw->batch.kind != kind || drw->batch.pixel != pixel
+	|| drw->batch.n == DRW_BATCH))
+		drw_flush(drw);
+	drw->batch.kind = kind;
+	drw->batch.pixel = pixel;
+}
+
 void
 drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert)
 {
+	XRectangle *r;
+
 	if (!drw || !drw->scheme)
 		return;
-	XSetForeground(drw->dpy, drw->gc, invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
-	if (filled)
-		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-	else
-		XDrawRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w - 1, h - 1);
+	batch(drw, filled ? BatchFill : BatchOutline,
+		invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
+	r = &drw->batch.rects[drw->batch.n++];
+	r->x = x;
+	r->y = y;
+	r->width = filled ? w : w - 1;
+	r->height = filled ? h : h - 1;
 }
 
 void
 drw_line(Drw *drw, int x1, int y1, int x2, int y2, int invert)
 {
+	XSegment *s;
+
 	if (!drw || !drw->scheme)
 		return;
-	XSetForeground(drw->dpy, drw->gc, invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
-	XDrawLine(drw->dpy, drw->drawable,drw->gc, x1, y1, x2, y2);
+	batch(drw, BatchLine, invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
+	s = &drw->batch.segs[drw->batch.n++];
+	s->x1 = x1;
+	s->y1 = y1;
+	s->x2 = x2;
+	s->y2 = y2;
+}
+
+static void
+asciiinit(Fnt *font)
+{
+	XGlyphInfo ext;
+	XftChar8 ch;
+	int i;
+
+	for (i = 0; i < 0x80; i++) {
+		font->ascii[i] = -1;
+		ch = i;
+		if (i >= ' ' && i < 0x7f && XftCharExists(font->dpy, font->xfont, i)) {
+			XftTextExtents8(font->dpy, font->xfont, &ch, 1, &ext);
+			font->ascii[i] = ext.xOff;
+		}
+	}
+	font->hasascii = 1;
+}
+
+/* looks for a font with cp through fontconfig and appends it to the
+ * fontset, NULL if there is none or enough were appended already */
+static Fnt *
+fontmatch(Drw *drw, long cp)
+{
+	Fnt *font, *curfont;
+	FcCharSet *fccharset;
+	FcPattern *fcpattern;
+	FcPattern *match;
+	XftResult result;
+
+	if (fallbacks >= FALLBACK_MAX)
+		return NULL;
+	if (!drw->fonts->pattern) {
+		/* Refer to the comment in xfont_create for more information. */
+		die("the first font in the cache must be loaded from a font string.");
+	}
+
+	fccharset = FcCharSetCreate();
+	FcCharSetAddChar(fccharset, cp);
+
+	fcpattern = FcPatternDuplicate(drw->fonts->pattern);
+	FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+	FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+	FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
+
+	FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
+	FcDefaultSubstitute(fcpattern);
+	match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
+
+	FcCharSetDestroy(fccharset);
+	FcPatternDestroy(fcpattern);
+
+	if (!match)
+		return NULL;
+	font = xfont_create(drw, NULL, match);
+	if (!font || !XftCharExists(drw->dpy, font->xfont, cp)) {
+		xfont_free(font);
+		return NULL;
+	}
+	for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+		; /* NOP */
+	curfont->next = font;
+	fallbacks++;
+	return font;
+}
+
+/* the font of the fontset that draws cp, the first one if none has it */
+static Fnt *
+fontfor(Drw *drw, long cp)
+{
+	GlyphFont *g;
+	Fnt *font;
+	size_t i;
+
+	if (!drw->fonts->hasascii)
+		asciiinit(drw->fonts);
+	if (cp >= 0 && cp < 0x80 && drw->fonts->ascii[cp] >= 0)
+		return drw->fonts;
+
+	glyphlookups++;
+	for (i = (unsigned long)cp * 2654435761UL; ; i++) {
+		g = &glyphfonts[i & (GLYPHCACHE_SIZE - 1)];
+		if (!g->set)
+			break;
+		if (g->set == drw->fonts && g->cp == cp) {
+			glyphhits++;
+			return g->font;
+		}
+	}
+
+	for (font = drw->fonts; font; font = font->next)
+		if (XftCharExists(drw->dpy, font->xfont, cp))
+			break;
+	if (!font && !(font = fontmatch(drw, cp))) {
+		glyphnomatch++;
+		font = drw->fonts;
+	}
+
+	/* probing needs free slots, start over when three quarters are used */
+	if (++glyphused > GLYPHCACHE_SIZE / 4 * 3) {
+		memset(glyphfonts, 0, sizeof(glyphfonts));
+		glyphused = 1;
+		g = &glyphfonts[(unsigned long)cp * 2654435761UL & (GLYPHCACHE_SIZE - 1)];
+	}
+	g->set = drw->fonts;
+	g->cp = cp;
+	g->font = font;
+	return font;
 }
 
 int
@@ -440,17 +689,11 @@ drw_text_x(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int
 	char buf[1024];
 	int ty;
 	unsigned int ew;
-	XftDraw *d = NULL;
-	Fnt *usedfont, *curfont, *nextfont;
+	Fnt *usedfont, *nextfont;
 	size_t i, len;
 	int utf8strlen, utf8charlen, render = x || y || w || h;
 	long utf8codepoint = 0;
 	const char *utf8str;
-	FcCharSet *fccharset;
-	FcPattern *fcpattern;
-	FcPattern *match;
-	XftResult result;
-	int charexists = 0;
 
 	if (!drw || (render && !drw->scheme) || !text || !drw->fonts)
 		return 0;
@@ -458,12 +701,10 @@ drw_text_x(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int
 	if (!render) {
 		w = ~w;
 	} else {
+		drw_flush(drw);
 		XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
 		if (hasbackground)
 			XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-		d = XftDrawCreate(drw->dpy, drw->drawable,
-		                  DefaultVisual(drw->dpy, drw->screen),
-		                  DefaultColormap(drw->dpy, drw->screen));
 		x += lpad;
 		w -= lpad;
 	}
@@ -475,23 +716,10 @@ drw_text_x(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int
 		nextfont = NULL;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					if (curfont == usedfont) {
-						utf8strlen += utf8charlen;
-						text += utf8charlen;
-					} else {
-						nextfont = curfont;
-					}
-					break;
-				}
-			}
-
-			if (!charexists || nextfont)
+			if ((nextfont = fontfor(drw, utf8codepoint)) != usedfont)
 				break;
-			else
-				charexists = 0;
+			utf8strlen += utf8charlen;
+			text += utf8charlen;
 		}
 
 		if (utf8strlen) {
@@ -509,7 +737,7 @@ drw_text_x(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int
 
 				if (render) {
 					ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-					XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
+					XftDrawStringUtf8(drw->xftdraw, &drw->scheme[invert ? ColBg : ColFg],
 					                  usedfont->xfont, x, ty, (XftChar8 *)buf, len);
 				}
 				x += ew;
@@ -517,51 +745,10 @@ drw_text_x(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int
 			}
 		}
 
-		if (!*text) {
+		if (!*text)
 			break;
-		} else if (nextfont) {
-			charexists = 0;
-			usedfont = nextfont;
-		} else {
-			/* Regardless of whether or not a fallback font is found, the
-			 * character must be drawn. */
-			charexists = 1;
-
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
-
-			if (!drw->fonts->pattern) {
-				/* Refer to the comment in xfont_create for more information. */
-				die("the first font in the cache must be loaded from a font string.");
-			}
-
-			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
-			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-			FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
-
-			FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-			FcDefaultSubstitute(fcpattern);
-			match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
-
-			FcCharSetDestroy(fccharset);
-			FcPatternDestroy(fcpattern);
-
-			if (match) {
-				usedfont = xfont_create(drw, NULL, match);
-				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
-				} else {
-					xfont_free(usedfont);
-					usedfont = drw->fonts;
-				}
-			}
-		}
+		usedfont = nextfont;
 	}
-	if (d)
-		XftDrawDestroy(d);
 
 	return x + (render ? w : 0);
 }
@@ -578,16 +765,120 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 	if (!drw)
 		return;
 
+	drw_flush(drw);
 	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
 	XSync(drw->dpy, False);
+	roundtrips++;
+}
+
+/* the width of text if it is printable ASCII that font has, which is what
+ * XftTextExtentsUtf8 would add up as well */
+static int
+asciiwidth(Fnt *font, const char *text, unsigned int *w)
+{
+	unsigned int sum = 0;
+
+	if (!font->hasascii)
+		asciiinit(font);
+	for (; *text; text++) {
+		if ((unsigned char)*text >= 0x80 || font->ascii[(unsigned char)*text] < 0)
+			return 0;
+		sum += font->ascii[(unsigned char)*text];
+	}
+	*w = sum;
+	return 1;
+}
+
+static unsigned long
+texthash(Fnt *set, const char *text)
+{
+	unsigned long h = 14695981039346656037UL ^ (unsigned long)set;
+
+	for (; *text; text++)
+		h = (h ^ (unsigned char)*text) * 1099511628211UL;
+	return h;
+}
+
+static void
+textunlink(TextExt *e)
+{
+	TextExt **p;
+
+	for (p = &textbuckets[e->hash % TEXTCACHE_BUCKETS]; *p != e; p = &(*p)->hnext);
+	*p = e->hnext;
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+}
+
+static void
+textfront(TextExt *e)
+{
+	e->prev = &textlru;
+	e->next = textlru.next;
+	textlru.next->prev = e;
+	textlru.next = e;
 }
 
 unsigned int
 drw_fontset_getwidth(Drw *drw, const char *text)
 {
+	TextExt *e;
+	unsigned long h;
+	unsigned int w;
+
 	if (!drw || !drw->fonts || !text)
 		return 0;
-	return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if (asciiwidth(drw->fonts, text, &w)) {
+		textascii++;
+		return w;
+	}
+	if (strlen(text) >= TEXTCACHE_LEN)
+		return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+
+	h = texthash(drw->fonts, text);
+	for (e = textbuckets[h % TEXTCACHE_BUCKETS]; e; e = e->hnext) {
+		if (e->hash == h && e->set == drw->fonts && !strcmp(e->text, text)) {
+			e->prev->next = e->next;
+			e->next->prev = e->prev;
+			textfront(e);
+			texthits++;
+			return e->w;
+		}
+	}
+	textmisses++;
+	w = drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+
+	if (textused < TEXTCACHE_SIZE) {
+		e = &textexts[textused++];
+	} else {
+		e = textlru.prev;
+		textunlink(e);
+	}
+	e->set = drw->fonts;
+	e->hash = h;
+	e->w = w;
+	strcpy(e->text, text);
+	e->hnext = textbuckets[h % TEXTCACHE_BUCKETS];
+	textbuckets[h % TEXTCACHE_BUCKETS] = e;
+	textfront(e);
+	return w;
+}
+
+void
+drw_fontset_stats(unsigned long *ascii, unsigned long *hits, unsigned long *misses)
+{
+	*ascii = textascii;
+	*hits = texthits;
+	*misses = textmisses;
+}
+
+void
+drw_glyph_stats(unsigned long *hits, unsigned long *lookups, unsigned long *nomatch, unsigned long *fallbackfonts)
+{
+	*hits = glyphhits;
+	*lookups = glyphlookups;
+	*nomatch = glyphnomatch;
+	*fallbackfonts = fallbacks;
 }
 
 void
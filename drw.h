@@ -9,12 +9,16 @@ typedef struct Fnt {
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	short ascii[128]; /* advances, -1 where the font has no glyph, see drw.c */
+	int hasascii;
 	struct Fnt *next;
 } Fnt;
 
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
+#define DRW_BATCH 64
+
 typedef struct {
 	unsigned int w, h;
 	Display *dpy;
@@ -22,21 +26,31 @@ typedef struct {
 	Window root;
 	Drawable drawable;
 	Picture picture;
+	XftDraw *xftdraw; /* on drawable */
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	struct {
+		int kind, n;
+		unsigned long pixel;
+		XRectangle rects[DRW_BATCH];
+		XSegment segs[DRW_BATCH];
+	} batch; /* queued drw_rect/drw_line calls, see drw_flush */
 } Drw;
 
 /* Drawable abstraction */
 Drw *drw_create(Display *dpy, int screen, Window win, unsigned int w, unsigned int h);
 void drw_resize(Drw *drw, unsigned int w, unsigned int h);
 void drw_free(Drw *drw);
+void drw_flush(Drw *drw);
 
 /* Fnt abstraction */
 Fnt *drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount);
 void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 void drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h);
+void drw_fontset_stats(unsigned long *ascii, unsigned long *hits, unsigned long *misses);
+void drw_glyph_stats(unsigned long *hits, unsigned long *lookups, unsigned long *nomatch, unsigned long *fallbacks);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname);
@@ -63,9 +77,13 @@ void drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 
 Picture drw_resize_picture(Drw *drw, Picture src, unsigned int srcw, unsigned int srch,  unsigned int dstw, unsigned int dsth);
 Picture drw_blur_picture(Drw *drw, Picture src, unsigned int srcw, unsigned int srch,  unsigned int dstw, unsigned int dsth);
+void drw_pixmap_put_argb(Drw *drw, Pixmap pm, char *src, int x, int y, unsigned int w, unsigned int h);
+Pixmap drw_pixmap_create_argb(Drw *drw, char *src, unsigned int w, unsigned int h);
+Picture drw_picture_create_scaled(Drw *drw, Pixmap pm, unsigned int src_w, unsigned int src_h, unsigned int dst_w, unsigned int dst_h);
 Picture drw_picture_create_resized(Drw *drw, char *src, unsigned int src_w, unsigned int src_h, unsigned int dst_w, unsigned int dst_h);
 Picture drw_picture_load_resized(Drw *drw, char *file, unsigned int src_w, unsigned int src_h, unsigned int dst_w, unsigned int dst_h);
 void drw_pic(Drw *drw, int x, int y, unsigned int w, unsigned int h, Picture pic);
+void drw_pic_part(Drw *drw, int x, int y, unsigned int w, unsigned int h, Picture pic, int sx, int sy);
 
 
 Imlib_Image scrotGrabWindowById(Display *dpy, Window root, Screen *scr, Window window);
@@ -73,3 +91,7 @@ Imlib_Image scrotGrabWindowById(Display *dpy, Window root, Screen *scr, Window w
 Picture drw_picture_image_resized(Drw *drw, Imlib_Image image, unsigned int srcw, unsigned int srch, unsigned int dstw, unsigned int dsth);
 
 void initimlib(Display *disp, Window root, Screen *scr);
+
+/* requests that wait for the server's reply, counted by the helpers that
+ * issue them on dwm's hot paths (getprop, drw_map, ...), see metrics.c */
+extern unsigned long roundtrips;
@@ -56,7 +56,9 @@ typedef enum IPCMessageType {
   IPC_TYPE_GET_DWM_CLIENT = 4,
   IPC_TYPE_GET_DWM_CLIENTS = 7,
   IPC_TYPE_SUBSCRIBE = 5,
-  IPC_TYPE_EVENT = 6
+  IPC_TYPE_EVENT = 6,
+  IPC_TYPE_GET_STATS = 8,
+  IPC_TYPE_DUMP_TRACE = 9
 } IPCMessageType;
 
 // Every IPC message must begin with this
@@ -186,6 +188,7 @@ static void
 connect_to_socket()
 {
   struct sockaddr_un addr;
+  const char *path = getenv("DWM_SOCKET");
 
   int sock = socket(AF_UNIX, SOCK_STREAM, 0);
 
@@ -193,7 +196,9 @@ connect_to_socket()
   memset(&addr, 0, sizeof(struct sockaddr_un));
 
   addr.sun_family = AF_UNIX;
-  strcpy(addr.sun_path, DEFAULT_SOCKET_PATH);
+  // Same override as dwm, for a second instance such as the benchmarks
+  if (!path || !*path) path = DEFAULT_SOCKET_PATH;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
 
   connect(sock, (const struct sockaddr *)&addr, sizeof(struct sockaddr_un));
 
@@ -416,6 +421,45 @@ get_dwm_clients()
   return 0;
 }
 
+static int
+get_stats()
+{
+  send_message(IPC_TYPE_GET_STATS, 1, (uint8_t *)"");
+  print_socket_reply();
+  return 0;
+}
+
+static int
+dump_trace(const char *path)
+{
+  const unsigned char *msg;
+  size_t msg_size;
+
+  yajl_gen gen = yajl_gen_alloc(NULL);
+
+  // Message format:
+  // {
+  //   "path": "<file>"   (optional, dwm picks one in /tmp otherwise)
+  // }
+  // clang-format off
+  YMAP(
+    if (path) {
+      YSTR("path"); YSTR(path);
+    }
+  )
+  // clang-format on
+
+  yajl_gen_get_buf(gen, &msg, &msg_size);
+
+  send_message(IPC_TYPE_DUMP_TRACE, msg_size, (uint8_t *)msg);
+
+  print_socket_reply();
+
+  yajl_gen_free(gen);
+
+  return 0;
+}
+
 static int
 subscribe(const char *event)
 {
@@ -481,6 +525,10 @@ print_usage(const char *name)
   puts("");
   puts("  get_dwm_client <window_id>      Get dwm client proprties");
   puts("");
+  puts("  get_stats                       Get event, layout and drawing latencies");
+  puts("");
+  puts("  dump_trace [file]               Write the trace as chrome trace JSON");
+  puts("");
   puts("  subscribe [events...]           Subscribe to specified events");
   puts("                                  Options: " IPC_EVENT_TAG_CHANGE ",");
   puts("                                  " IPC_EVENT_LAYOUT_CHANGE ",");
@@ -495,6 +543,9 @@ print_usage(const char *name)
   puts("  --ignore-reply                  Don't print reply messages from");
   puts("                                  run_command and subscribe.");
   puts("");
+  puts("Environment:");
+  puts("  DWM_SOCKET                      Socket path instead of the default");
+  puts("");
 }
 
 int
@@ -544,6 +595,10 @@ main(int argc, char *argv[])
       usage_error(prog_name, "Expected the window id");
   } else if (strcmp(argv[i], "get_dwm_clients") == 0) {
     get_dwm_clients();
+  } else if (strcmp(argv[i], "get_stats") == 0) {
+    get_stats();
+  } else if (strcmp(argv[i], "dump_trace") == 0) {
+    dump_trace(++i < argc ? argv[i] : NULL);
   } else if (strcmp(argv[i], "subscribe") == 0) {
     if (++i < argc) {
       for (int j = i; j < argc; j++) subscribe(argv[j]);
@@ -40,6 +40,7 @@
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
 #ifdef XINERAMA
@@ -53,7 +54,9 @@
 #include <stdint.h>
 #include <Imlib2.h>
 #include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xrender.h>
+#include <xcb/xcb.h>
 
 #include "http.c"
 #include "drw.h"
@@ -66,7 +69,7 @@
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->wx+(m)->ww) - MAX((x),(m)->wx)) \
                                * MAX(0, MIN((y)+(h),(m)->wy+(m)->wh) - MAX((y),(m)->wy)))
 #define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]))
-#define HIDDEN(C)               ((getstate(C->win) == IconicState))
+#define HIDDEN(C)               ((C)->state == IconicState && !(C)->tagunmapped)
 #define LENGTH(X)               (sizeof X / sizeof X[0])
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
@@ -115,15 +118,19 @@ enum { SchemeNorm, SchemeSel , SchemeScr,SchemeInvalidNormal, SchemeInvalidSel,S
 enum { NetSupported, NetWMName, NetWMIcon, NetWMState, NetWMCheck,
        NetSystemTray, NetSystemTrayOP, NetSystemTrayOrientation, NetSystemTrayOrientationHorz,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-	   NetWmStateSkipTaskbar,
+	   NetWmStateSkipTaskbar, NetWMStateHidden,
 	   NetWmPid,
        NetWMWindowTypeDialog, NetClientList, NetDesktopNames, NetDesktopViewport, NetNumberOfDesktops, NetCurrentDesktop, 
-	   NetMyNote,
+	   NetMyNote, NetWMBypassCompositor,
 	   NetLast }; /* EWMH atoms */
 enum { Manager, Xembed, XembedInfo, XLast }; /* Xembed atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { DirtyLayout, DirtyStack, DirtyBar, DirtySticky, DirtySwitcher,
+       DirtyClientList, DirtyLast }; /* deferred work, see markdirty() */
+enum { TraceLog, TraceX, TraceArrange, TraceDraw, TracePlacement,
+       TraceLast }; /* trace categories, see trace.c */
 
 typedef struct TagState TagState;
 struct TagState {
@@ -166,8 +173,32 @@ typedef struct {
 	const Arg arg;
 } Button;
 
+typedef struct {
+	Pixmap pm;
+	unsigned int w, h;
+	unsigned long key; /* of what pm shows, see scene.c */
+} Tile;
+
+typedef struct {
+	int source;
+	const char *arg;       /* strftime format, file or shell command */
+	unsigned int interval; /* seconds */
+} StatusBlock;
+
+enum { StatusTime, StatusFile, StatusCmd }; /* status block sources */
+enum { SegStatus, SegTag, SegLayout, SegLauncher, SegTitle, SegFill }; /* bar segments */
+
 typedef struct Monitor Monitor;
 typedef struct Client Client;
+typedef struct Icon Icon; /* see icon.c */
+
+typedef struct {
+	int kind;
+	int index;  /* tag, launcher, visible client; status: the signal before the block */
+	Client *c;  /* SegTitle */
+	int x, w;
+	unsigned long key; /* of what it shows, see bar.c */
+} BarSeg;
 typedef struct Container Container;
 struct Container {
 	int id;
@@ -227,9 +258,20 @@ struct Client {
 	unsigned long pid;
 	int isscratched;
 	float factx, facty;
-	unsigned int icw, ich; Picture icon;
-	unsigned int icws[3], ichs[3]; Picture icons[3];
-	Picture preview;
+	unsigned int icw, ich; Icon *icon;
+	unsigned int icws[3], ichs[3]; Icon *icons[3];
+	Picture preview;     /* scaled copy for the switcher, see preview.c */
+	Picture previewsrc;  /* the window itself */
+	Damage damage;
+	int previeww, previewh, previewsrcw, previewsrch, previewdirty;
+	int previewsrctw, previewsrcth; /* size the previewsrc transform scales to */
+	unsigned long previewused, redirectbytes; /* last drawn, pixmap size while redirected */
+	unsigned long previewgen; /* bumped whenever preview changes */
+	Tile tile, stickytile; /* last switcher renderings */
+	Clr *tilebg; /* switcher background, see switcherbg() */
+	unsigned long tilebgkey;
+	long tilebgtime;
+	int bypasscompositor;
 	MXY matcoor;
 	int launchindex;
 
@@ -245,6 +287,12 @@ struct Client {
 	char shortcut[5];
 	Client *subclient;
 	Client *parentclient;
+	int attached; /* in mon->clients and counted in mon->tagclients */
+	Client *wnext; /* next in the same wintable bucket */
+	long state; /* WM_STATE as last written or reported, -1 if unset */
+	int statewrites; /* our WM_STATE writes whose PropertyNotify is still to come */
+	int tagunmapped; /* unmapped by showhide() because its tags are not shown */
+	int ignoreunmap; /* UnmapNotify events of our own unmaps still to come */
 };
 
 
@@ -306,11 +354,17 @@ struct Monitor {
 	int switcherbarww, switcherbarwh, switcherbarwx, switcherbarwy;
 	int switcherstickyww, switcherstickywh, switcherstickywx, switcherstickywy;
 	SwitcherAction switcheraction, switcherbaraction, switcherstickyaction;
+	Tile tagtiles[32]; /* switcher areas of the tags */
+	BarSeg *barsegs;
+	int nbarsegs, barsegi, barsegcap, barw;
 	const Layout *lt[2];
 	const Layout *lastlt;
 	Pertag *pertag;
 	int systrayrx, systrayy;
 	int camera_center_x, camera_center_y;
+	unsigned int dirty;   /* 1 << Dirty* still to be done in this batch */
+	int tagclients[32];   /* attached clients per tag bit */
+	int tagurgent[32];    /* urgent ones among them */
 };
 
 typedef struct {
@@ -436,6 +490,10 @@ static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
 static void attach(Client *c);
 static void attachstack(Client *c);
+static void setclienttags(Client *c, unsigned int tags);
+static void setclienturgent(Client *c, int urg);
+static void tagstatecount(Client *c, int d);
+static void tagstaterebuild(void);
 static void addtoscratchgroup(const Arg *arg);
 static void assemble(const Arg *arg);
 static void assemblecsv(const Arg *arg);
@@ -459,6 +517,8 @@ static void detachstack(Client *c);
 static Monitor *dirtomon(int dir);
 static void drawbar(Monitor *m);
 static void drawbars(void);
+static void markdirty(Monitor *m, int what);
+static void flushdirty(void);
 static void drawswitcher(Monitor *m);
 static void destroyswitcher(Monitor *m);
 static void drawswitchersticky(Monitor *m);
@@ -469,6 +529,7 @@ static void doublepagemark(const Arg *arg);
 static void dismiss(const Arg *arg);
 static void cleardoublepage(int view);
 static void toggleswitchers(const Arg *arg);
+static void toggleswitcherpreview(const Arg *arg);
 static void toggleswitchersticky(const Arg *arg);
 static void enqueue(Client *c);
 static void enqueuestack(Client *c);
@@ -500,14 +561,13 @@ static unsigned int getmaxtags();
 static int getwindowptr(int *x, int *y, Window win);
 static int getrootptr(int *x, int *y);
 static long getstate(Window w);
+static int getcurtagindex(Monitor *m);
 static unsigned int getsystraywidth();
-static pid_t getstatusbarpid();
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
 static int handlexevent(struct epoll_event *ev);
 static long getcurrusec();
-static Picture geticonprop(Window w, unsigned int *icw, unsigned int *ich);
 static unsigned long getwindowpid(Window w);
 static void hidescratchgroup(ScratchGroup *sg);
 static void hidescratchgroupv(ScratchGroup *sg, int isarrange);
@@ -570,6 +630,7 @@ static void setupepoll(void);
 static void setviewport(void);
 static void seturgent(Client *c, int urg);
 static void showhide(Client *c);
+static void tagcapture(Client *c);
 static void sigchld(int unused);
 static void sigstatusbar(const Arg *arg);
 static void sighup(int unused);
@@ -635,8 +696,6 @@ static void updateclass(Client *c);
 static void updatenote(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
-static void updateicon(Client *c);
-static void updateicons(Client *c);
 static void updateswitchersticky(Monitor *m);
 static void updateborder(Client *c);
 static void view(const Arg *arg);
@@ -650,6 +709,9 @@ static void replacechar(char *buf, char old, char new);
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
 static Client *wintosystrayicon(Window w);
+static void wintableadd(Client **table, unsigned int size, Client *c);
+static void wintabledel(Client **table, unsigned int size, Client *c);
+static Client *wintablefind(Client **table, unsigned int size, Window w);
 static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
 static int xerrorstart(Display *dpy, XErrorEvent *ee);
@@ -709,7 +771,6 @@ static int fill4x(rect_t sc, int centerx, int centery, int centerw, int centerh,
 									int w, int h, int stepw, int steph, int n, rect_t ts[], int tsn, rect_t *r, double maxintersectradio);
 static void drawclientswitcherwin(Window win, int ww, int wh);
 static void removefromscratchgroupc(Client *c);
-static Picture getwindowpic(Client *c);
 static void setborderwidth(Client *c, int borderpx);
 static void arrangescratch(ScratchGroup *sg);
 static void shownonscratchs();
@@ -728,6 +789,8 @@ static void i_switcherfocuschange(const Arg *arg);
 int ispointin(int x, int y, rect_t t);
 
 static void LOG(char *content,char *content2);
+static void LOG_FORMAT(char *format, ...);
+static int tracedump(const char *path);
 
 /* variables */
 static Systray *systray = NULL;
@@ -772,6 +835,9 @@ static Clr **gradual_scheme;
 static Display *dpy;
 static Drw *drw;
 static Monitor *mons, *selmon, *lastselmon;
+/* managed clients and systray icons by window, sizes are powers of two */
+static Client *clienttable[512];
+static Client *systraytable[32];
 static Window root, wmcheckwin, borderwintop, borderwinbottom, borderwinleft, borderwinright;
 static Window cornerwin1, cornerwin2, cornerwin3, cornerwin4;
 static Client *focuschain, *FC_HEAD;
@@ -801,6 +867,16 @@ static long lastnexthidetime;
 
 static int switchercurtagindex;
 
+/* while an X event batch is handled, arrange/restack/bar work is only
+ * recorded and done once by flushdirty() */
+static int deferring = 0;
+static int dirtyclientlist = 0;
+static unsigned long dirtymarks[DirtyLast];   /* requests */
+static unsigned long dirtyflushes[DirtyLast]; /* work actually done */
+static const char *dirtynames[DirtyLast] = {
+	[DirtyLayout] = "layout", [DirtyStack] = "stack", [DirtyBar] = "bar",
+	[DirtySticky] = "sticky", [DirtySwitcher] = "switcher", [DirtyClientList] = "clientlist",
+};
 /*static float tile6initwinfactor = 0.9;*/
 static float tile6initwinfactor = 1;
 static float lasttile6initwinfactor = 0.9;
@@ -846,40 +922,27 @@ struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 static MXY spiral_index[] = {{0,0},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1},{1,0},{1,1},{1,2},{0,2},{-1,2},{-2,2},{-2,1},{-2,0},{-2,-1},{-2,-2},{-1,-2},{0,-2},{1,-2},{2,-2},{2,-1},{2,0},{2,1},{2,2},{2,3},{1,3},{0,3},{-1,3},{-2,3},{-3,3},{-3,2},{-3,1},{-3,0},{-3,-1},{-3,-2},{-3,-3},{-2,-3},{-1,-3},{0,-3},{1,-3},{2,-3},{3,-3},{3,-2},{3,-1},{3,0},{3,1},{3,2},{3,3},{3,4},{2,4},{1,4},{0,4},{-1,4},{-2,4},{-3,4},{-4,4},{-4,3},{-4,2},{-4,1},{-4,0},{-4,-1},{-4,-2},{-4,-3},{-4,-4},{-3,-4},{-2,-4},{-1,-4},{0,-4},{1,-4},{2,-4},{3,-4},{4,-4},{4,-3},{4,-2},{4,-1},{4,0},{4,1},{4,2},{4,3},{4,4},{4,5},{3,5},{2,5},{1,5},{0,5},{-1,5},{-2,5},{-3,5},{-4,5},{-5,5},{-5,4},{-5,3},{-5,2},{-5,1},{-5,0},{-5,-1},{-5,-2},{-5,-3},{-5,-4},{-5,-5},{-4,-5},{-3,-5},{-2,-5},{-1,-5},{0,-5},{1,-5},{2,-5},{3,-5},{4,-5},{5,-5},{5,-4},{5,-3},{5,-2},{5,-1},{5,0},{5,1},{5,2},{5,3},{5,4},{5,5}};
 
 
-void
-LOG(char *content, char * content2){
-	if(!islog) return;
-	fprintf(logfile,"%s%s\n", content, content2);
-}
-
-void
-LOG_FORMAT(char *format, ...){
-
-	if(!islog) return;
+#include "trace.c"
 
-	struct timeval us;
-	gettimeofday(&us, NULL);
-
-	time_t tnow;
-	tnow=time(0); 
-	struct tm *sttm;  
-	sttm=localtime(&tnow);
-	fprintf(logfile, "%04u-%02u-%02u %02u:%02u:%02u.%03u: ", sttm->tm_year + 1900, sttm->tm_mon + 1,
-			sttm->tm_mday, sttm->tm_hour, sttm->tm_min, sttm->tm_sec, us.tv_usec/1000);
-	va_list ap;
-	va_start(ap,format);
-	vfprintf(logfile,format, ap);
-	fprintf(logfile,"\n");
-	va_end(ap);
-	fflush(logfile);
-}
+#include "smartwin.c"
+#include "placement.c"
+#include "prop.c"
+#include "thumb.c"
+#include "icon.c"
+#include "scene.c"
+#include "bar.c"
+#include "preview.c"
+#include "spawn.c"
+#include "status.c"
+#include "proc.c"
+#include "metrics.c"
 
 void 
 getclass(Window w, char c[])
 {
 
 	XClassHint ch = { NULL, NULL };
-	XGetClassHint(dpy, w, &ch);
+	propclasshint(w, &ch);
 	char *class = ch.res_class ? ch.res_class : broken;
 
 	strcpy(c, class);
@@ -919,9 +982,9 @@ applyrules(Client *c)
 
 	/* rule matching */
 	c->isfloating = 0;
-	c->tags = 0;
+	setclienttags(c, 0);
 	c->nstub = 0;
-	XGetClassHint(dpy, c->win, &ch);
+	propclasshint(c->win, &ch);
 	class    = ch.res_class ? ch.res_class : broken;
 	instance = ch.res_name  ? ch.res_name  : broken;
 
@@ -932,7 +995,7 @@ applyrules(Client *c)
 		&& (!r->instance || strstr(instance, r->instance)))
 		{
 			c->isfloating = r->isfloating;
-			c->tags |= r->tags;
+			setclienttags(c, c->tags | r->tags);
 			c->priority = r->priority;
 			c->nstub = r->nstub;
 			if (r->isscratch)
@@ -946,7 +1009,7 @@ applyrules(Client *c)
 		XFree(ch.res_class);
 	if (ch.res_name)
 		XFree(ch.res_name);
-	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+	setclienttags(c, c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags]);
 }
 
 
@@ -1005,8 +1068,8 @@ rerule(const Arg *arg)
 
 		/* rule matching */
 		c->isfloating = 0;
-		c->tags = 0;
-		XGetClassHint(dpy, c->win, &ch);
+		setclienttags(c, 0);
+		propclasshint(c->win, &ch);
 		class    = ch.res_class ? ch.res_class : broken;
 		instance = ch.res_name  ? ch.res_name  : broken;
 
@@ -1017,7 +1080,7 @@ rerule(const Arg *arg)
 			&& (!r->instance || strstr(instance, r->instance)))
 			{
 				c->isfloating = r->isfloating;
-				c->tags |= r->tags;
+				setclienttags(c, c->tags | r->tags);
 				c->priority = r->priority;
 				c->nstub = r->nstub;
 				for (m = mons; m && m->num != r->monitor; m = m->next);
@@ -1034,9 +1097,11 @@ rerule(const Arg *arg)
 	for(c = selmon->clients; c; c = c->next)
 	{
 		if (c->tags == 0)
-			c->tags = maxtags << 1;
-		c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+			setclienttags(c, maxtags << 1);
+		setclienttags(c, c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags]);
 	}
+	/* rules may have moved clients between monitors behind attach() */
+	tagstaterebuild();
 	selmon->sellt = 0;
 	arrange(selmon);
 	if(selmon->sel){
@@ -1117,10 +1182,13 @@ void
 arrange(Monitor *m)
 {
 	LOG_FORMAT("arrange 1");
-	if (m)
+	if (m) {
+		tagcapture(m->stack);
 		showhide(m->stack);
-	else for (m = mons; m; m = m->next)
+	} else for (m = mons; m; m = m->next) {
+		tagcapture(m->stack);
 		showhide(m->stack);
+	}
 	LOG_FORMAT("arrange 2");
 	if (m) {
 		LOG_FORMAT("arrange 3");
@@ -1131,9 +1199,8 @@ arrange(Monitor *m)
 	} else for (m = mons; m; m = m->next)
 		arrangemon(m);
 	
-	if (m && m->switcherstickywin) {
-		m->switcherstickyaction.drawfunc(m->switcherstickywin, m->switcherstickyww, m->switcherstickywh);
-	}
+	if (m && m->switcherstickywin)
+		markdirty(m, DirtySticky);
 	if(showborderwin){
 		if (borderwintop) XMapRaised(dpy, borderwintop);
 		if (borderwinleft) XMapRaised(dpy, borderwinleft);
@@ -1148,6 +1215,98 @@ arrange(Monitor *m)
 	}
 }
 
+static void
+dirtyrun(Monitor *m, int what)
+{
+	dirtyflushes[what]++;
+	switch (what) {
+	case DirtyLayout:
+		arrange(m);
+		break;
+	case DirtyStack:
+		restack(m);
+		break;
+	case DirtyBar:
+		drawbar(m);
+		break;
+	case DirtySticky:
+		if (m->switcherstickywin)
+			m->switcherstickyaction.drawfunc(m->switcherstickywin, m->switcherstickyww, m->switcherstickywh);
+		break;
+	case DirtySwitcher:
+		if (m->switcher)
+			m->switcheraction.drawfunc(m->switcher, m->switcherww, m->switcherwh);
+		break;
+	case DirtyClientList:
+		updateclientlist();
+		break;
+	}
+}
+
+/* m == NULL marks every monitor.  outside of an event batch the work is
+ * done right away, so callers never have to care which case they are in. */
+void
+markdirty(Monitor *m, int what)
+{
+	Monitor *t;
+
+	dirtymarks[what]++;
+	if (what == DirtyClientList) {
+		if (deferring)
+			dirtyclientlist = 1;
+		else
+			dirtyrun(NULL, what);
+		return;
+	}
+	for (t = m ? m : mons; t; t = m ? NULL : t->next) {
+		if (deferring)
+			t->dirty |= 1 << what;
+		else
+			dirtyrun(t, what);
+	}
+}
+
+void
+flushdirty(void)
+{
+	Monitor *m;
+	unsigned int d;
+	int again, round;
+
+	/* arrange marks the bar and sticky switcher again, pick those up in
+	 * the next round instead of drawing them twice */
+	for (round = 0, again = 1; again && round < 4; round++) {
+		again = 0;
+		for (m = mons; m; m = m->next) {
+			if (!(d = m->dirty))
+				continue;
+			again = 1;
+			m->dirty = 0;
+			if (d & (1 << DirtyLayout)) {
+				dirtyrun(m, DirtyLayout);
+				d &= ~(1 << DirtyStack | 1 << DirtyBar | 1 << DirtySticky);
+			} else if (d & (1 << DirtyStack)) {
+				dirtyrun(m, DirtyStack);
+				d &= ~(1 << DirtyBar);
+			}
+			if (d & (1 << DirtySwitcher))
+				dirtyrun(m, DirtySwitcher);
+			if (d & (1 << DirtySticky))
+				dirtyrun(m, DirtySticky);
+			if (d & (1 << DirtyBar))
+				dirtyrun(m, DirtyBar);
+		}
+		if (dirtyclientlist) {
+			dirtyclientlist = 0;
+			dirtyrun(NULL, DirtyClientList);
+		}
+	}
+	LOG_FORMAT("flushdirty arrange %lu/%lu restack %lu/%lu bar %lu/%lu",
+		dirtyflushes[DirtyLayout], dirtymarks[DirtyLayout],
+		dirtyflushes[DirtyStack], dirtymarks[DirtyStack],
+		dirtyflushes[DirtyBar], dirtymarks[DirtyBar]);
+}
+
 void
 updateborder(Client *c){
 	if (ISVISIBLE(c) && c->win)
@@ -1200,8 +1359,11 @@ arrangemon(Monitor *m)
 	}
 	
 	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
-	if (m->lt[m->sellt]->arrange)
+	if (m->lt[m->sellt]->arrange) {
+		unsigned long long start = metricsnow();
 		m->lt[m->sellt]->arrange(m);
+		metricslayout(m->lt[m->sellt]->arrange, start);
+	}
 
 	arrangescratch(scratchgroupptr);
 }
@@ -1218,11 +1380,14 @@ void arrangemonlayout(Monitor *m, Layout *layout)
 // unused
 void arrangelayout(Monitor *m, Layout *layout)
 {
-	if (m)
+	if (m) {
+		tagcapture(m->stack);
 		showhide(m->stack);
-	else
-		for (m = mons; m; m = m->next)
+	} else
+		for (m = mons; m; m = m->next) {
+			tagcapture(m->stack);
 			showhide(m->stack);
+		}
 	if (m)
 	{
 		arrangemonlayout(m, layout);
@@ -1239,6 +1404,68 @@ attach(Client *c)
 {
 	c->next = c->mon->clients;
 	c->mon->clients = c;
+	c->attached = 1;
+	tagstatecount(c, 1);
+}
+
+/* occupancy and urgency per tag are kept up to date here instead of walking
+ * every client for each IPC update */
+void
+tagstatecount(Client *c, int d)
+{
+	unsigned int t;
+	int i;
+
+	if (!c->mon)
+		return;
+	for (t = c->tags, i = 0; t; t >>= 1, i++)
+		if (t & 1) {
+			c->mon->tagclients[i] += d;
+			if (c->isurgent)
+				c->mon->tagurgent[i] += d;
+		}
+}
+
+void
+setclienttags(Client *c, unsigned int tags)
+{
+	if (c->attached)
+		tagstatecount(c, -1);
+	c->tags = tags;
+	if (c->attached)
+		tagstatecount(c, 1);
+}
+
+void
+setclienturgent(Client *c, int urg)
+{
+	if (c->attached)
+		tagstatecount(c, -1);
+	c->isurgent = urg;
+	if (c->attached)
+		tagstatecount(c, 1);
+}
+
+void
+tagstaterebuild(void)
+{
+	Monitor *m;
+	Client *c;
+
+	for (m = mons; m; m = m->next) {
+		memset(m->tagclients, 0, sizeof(m->tagclients));
+		memset(m->tagurgent, 0, sizeof(m->tagurgent));
+	}
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next) {
+			if (c->mon != m) {
+				/* rerule() can point a client at another monitor */
+				c->attached = 0;
+				continue;
+			}
+			c->attached = 1;
+			tagstatecount(c, 1);
+		}
 }
 
 void
@@ -1252,12 +1479,11 @@ void
 buttonpress(XEvent *e)
 {
 	LOG_FORMAT("buttonpress 1");
-	unsigned int i, x, click;
+	unsigned int i, click;
 	Arg arg = {0};
 	Client *c;
 	Monitor *m;
 	XButtonPressedEvent *ev = &e->xbutton;
-	char *text, *s, ch;
 
 	if(showborderwin)
 	{
@@ -1300,75 +1526,38 @@ buttonpress(XEvent *e)
 		focus(NULL);
 	}
 	if (ev->window == selmon->barwin) {
-		i = x = 0;
-		unsigned int occ = 0;
-		for(c = m->clients; c; c=c->next)
-			occ |= c->tags;
-		do {
-			/* Do not reserve space for vacant tags */
-			if (!(occ & 1 << i || m->tagset[m->seltags] & 1 << i))
-				continue;
-			x += TEXTW(tags[i]);
-		} while (ev->x >= x && ++i < LENGTH(tags));
-		if (i < LENGTH(tags)) {
+		BarSeg *seg = barsegat(selmon, ev->x);
+
+		if (seg && seg->kind == SegTag) {
 			click = ClkTagBar;
-			arg.ui = 1 << i;
+			arg.ui = 1 << seg->index;
 			goto execute_handler;
-		} else if (ev->x < x + blw) {
+		} else if (seg && seg->kind == SegLayout) {
 			click = ClkLtSymbol;
 			goto execute_handler;
-		}
-
-		x += blw;
-
-		for(i = 0; i < LENGTH(launchers); i++) {
-			x += TEXTW(launchers[i].name);
-			if (ev->x < x) {
-				Arg a;
-				a.v = launchers[i].command;
-				spawn(&a);
-				return;
-			}
-		}
-
-		if (ev->x > selmon->ww - getsystraywidth() - statusw) {
-			x = selmon->ww - getsystraywidth() - statusw;
+		} else if (seg && seg->kind == SegLauncher) {
+			Arg a;
+			a.v = launchers[seg->index].command;
+			spawn(&a);
+			return;
+		} else if (seg && seg->kind == SegStatus) {
 			click = ClkStatusText;
-			statussig = 0;
-			for (text = s = stext; *s && x <= ev->x; s++) {
-				if ((unsigned char)(*s) < ' ') {
-					ch = *s;
-					*s = '\0';
-					x += TEXTW(text) - lrpad;
-					*s = ch;
-					text = s + 1;
-					if (x >= ev->x)
-						break;
-					statussig = ch;
-				}
-			}
+			statussig = seg->index;
 		} else
 		{
 			click = ClkWinTitle;
-			Client *c;
-			int i;
-			for(c = selmon->clients,i=0; c; c = c->next){
-				if ( ISVISIBLE(c) && ev->x > c->titlex && ev->x < (c->titlex+c->titlew))
+			if (seg && seg->kind == SegTitle)
+			{
+				c = seg->c;
+				if(ev->button == Button1)
 				{
-					if(ev->button == Button1)
-					{
-						/*focus(c);*/
-						Arg zoomiarg = {.i = i};
-						zoomi(&zoomiarg);
-					}
-					if (ev->button == Button3)
-					{
-						killclientc(c);
-					}
-					break;
+					/*focus(c);*/
+					Arg zoomiarg = {.i = seg->index};
+					zoomi(&zoomiarg);
 				}
-				if (ISVISIBLE(c)) {
-					i ++;
+				if (ev->button == Button3)
+				{
+					killclientc(c);
 				}
 			}
 		}
@@ -1483,6 +1672,10 @@ cleanup(void)
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
 
 	ipc_cleanup();
+	cleanupplacement();
+	cleanupthumb();
+	cleanupstatus();
+	cleanupproc();
 
 	if (close(epoll_fd) < 0) {
 			fprintf(stderr, "Failed to close epoll file descriptor\n");
@@ -1493,6 +1686,7 @@ void
 cleanupmon(Monitor *mon)
 {
 	Monitor *m;
+	int i;
 
 	if (mon == mons)
 		mons = mons->next;
@@ -1502,6 +1696,9 @@ cleanupmon(Monitor *mon)
 	}
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
+	for (i = 0; i < LENGTH(mon->tagtiles); i++)
+		tilefree(&mon->tagtiles[i]);
+	free(mon->barsegs);
 	free(mon);
 }
 
@@ -1527,6 +1724,7 @@ clientmessage(XEvent *e)
 			c->mon = selmon;
 			c->next = systray->icons;
 			systray->icons = c;
+			wintableadd(systraytable, LENGTH(systraytable), c);
 			if (!XGetWindowAttributes(dpy, c->win, &wa)) {
 				/* use sane defaults */
 				wa.width = bh;
@@ -1744,6 +1942,9 @@ detach(Client *c)
 
 	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
 	*tc = c->next;
+	if (c->attached)
+		tagstatecount(c, -1);
+	c->attached = 0;
 }
 
 void
@@ -1783,16 +1984,22 @@ drawbar(Monitor *m)
 	int boxw = drw->fonts->h / 6 + 2;
 	unsigned int i, occ = 0, urg = 0, n = 0, occt = 0;
 	Client *c;
+	unsigned long long start;
+	unsigned long key;
 
 	if (!m->showbar)
 		return;
+	start = metricsnow();
 
 	if(showsystray && m == systraytomon(m) && !systrayonleft)
 		stw = getsystraywidth();
 
+	resizebarwin(m);
+	barbegin(m, m->ww - stw);
+
 	/* draw status first so it can be overdrawn by tags later */
 	if (m == selmon) { // status is only drawn on selected monitor
-		char *text, *s, ch;
+		char *text, *s, ch, sig = 0;
 		drw_setscheme(drw, scheme[SchemeNorm]);
 
 		x = 0;
@@ -1801,18 +2008,20 @@ drawbar(Monitor *m)
 				ch = *s;
 				*s = '\0';
 				tw = TEXTW(text) - lrpad;
-				drw_text(drw, m->ww - stw - statusw + x, 0, tw, bh, 0, text, 0);
+				if (barseg(m, SegStatus, sig, NULL, m->ww - stw - statusw + x, tw, tilemixstr(0, text)))
+					drw_text(drw, m->ww - stw - statusw + x, 0, tw, bh, 0, text, 0);
 				x += tw;
 				*s = ch;
+				sig = ch;
 				text = s + 1;
 			}
 		}
 		tw = TEXTW(text) - lrpad + 2;
-		drw_text(drw, m->ww - stw - statusw + x, 0, tw, bh, 0, text, 0);
+		if (barseg(m, SegStatus, sig, NULL, m->ww - stw - statusw + x, tw, tilemixstr(0, text)))
+			drw_text(drw, m->ww - stw - statusw + x, 0, tw, bh, 0, text, 0);
 		tw = statusw;
 	}
 
-	resizebarwin(m);
 	for (c = m->clients; c; c = c->next) {
 		if (ISVISIBLE(c))
 			n++;
@@ -1831,9 +2040,10 @@ drawbar(Monitor *m)
 		if (occt & 1 << i) {
 			colorindex = SchemeTiled;
 		}
-		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel :colorindex]);
+		colorindex = m->tagset[m->seltags] & 1 << i ? SchemeSel : colorindex;
 
 		// update tag title
+		char tagname[20];
 		Client *c;
 		for(c = m->stack;c;c = c->snext){
 			if (!c->isfloating && (c->tags & (1 << i))) {
@@ -1841,27 +2051,35 @@ drawbar(Monitor *m)
 			}
 		}
 		if (c) {
-			char tagname[20];
 			int tagnamelen = strlen(tags[i]);
 			do {
 				tagnamelen ++;
 				snprintf(tagname, tagnamelen,"%d-%s",i + 1, c->name);
-			}while (TEXTW(tagname) < TEXTW(tags[i]) && tagnamelen < 20);
-			drw_text(drw, x, 0, w, bh, lrpad / 2,tagname, urg & 1 << i);
+			}while (TEXTW(tagname) < w && tagnamelen < 20);
 		}else {
-			drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
+			snprintf(tagname, sizeof(tagname), "%s", tags[i]);
+		}
+		key = tilemix(tilemix(tilemixstr(0, tagname), colorindex), !!(urg & 1 << i));
+		if (barseg(m, SegTag, i, NULL, x, w, key)) {
+			drw_setscheme(drw, scheme[colorindex]);
+			drw_text(drw, x, 0, w, bh, lrpad / 2, tagname, urg & 1 << i);
 		}
 
 		x += w;
 	}
 	w = blw = TEXTW(m->ltsymbol);
 	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+	if (barseg(m, SegLayout, 0, NULL, x, w, tilemixstr(0, m->ltsymbol)))
+		drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+	x += w;
 	
 	for (i = 0; i < LENGTH(launchers); i++)
 	{
 		w = TEXTW(launchers[i].name);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, launchers[i].name, urg & 1 << i);
+		if (barseg(m, SegLauncher, i, NULL, x, w, tilemix(tilemixstr(0, launchers[i].name), !!(urg & 1 << i)))) {
+			drw_setscheme(drw, scheme[SchemeNorm]);
+			drw_text(drw, x, 0, w, bh, lrpad / 2, launchers[i].name, urg & 1 << i);
+		}
 		x += w;
 	}
 
@@ -1884,33 +2102,42 @@ drawbar(Monitor *m)
 			if (i > 0)
 				mw += ew / i;
 
+			i = 0;
 			for (c = m->clients; c; c = c->next) {
 				if (!ISVISIBLE(c))
 					continue;
 				tw = MIN(m->sel == c ? w : mw, TEXTW(c->name));
 
-				drw_setscheme(drw, scheme[m->sel == c ? SchemeSel : SchemeNorm]);
-				if (tw > 0) /* trap special handling of 0 in drw_text */
+				key = tilemix(tilemixstr(0, c->name), (m->sel == c) | c->isfloating << 1 | c->isfixed << 2);
+				key = tilemix(key, c->icon ? c->icon->hash ^ (uintptr_t)c->icon : 0);
+				if (tw > 0 && barseg(m, SegTitle, i, c, x, tw, key)) /* trap special handling of 0 in drw_text */
 				{
+					drw_setscheme(drw, scheme[m->sel == c ? SchemeSel : SchemeNorm]);
 					if (c->icon) {
 						drw_text(drw, x, 0, tw, bh, lrpad / 2 + c->icw + ICONSPACING, c->name, 0);
-						drw_pic(drw, x + lrpad / 2, (bh - c->ich) / 2, c->icw, c->ich, c->icon);
+						drawicon(c->icon, x + lrpad / 2, (bh - c->ich) / 2);
 					}else{
 						drw_text(drw, x, 0, tw, bh, lrpad / 2, c->name, 0);
 					}
+					if (c->isfloating)
+						drw_rect(drw, x + boxs, boxs, boxw, boxw, c->isfixed, 0);
+				}
+				if (tw > 0) {
 					c->titlex = x;
 					c->titlew = tw;
 				}
-				if (c->isfloating)
-					drw_rect(drw, x + boxs, boxs, boxw, boxw, c->isfixed, 0);
 				x += tw;
 				w -= tw;
+				i++;
 			}
 		}
-		drw_setscheme(drw, scheme[SchemeNorm]);
-		drw_rect(drw, x, 0, w, bh, 1, 1);
+		if (barseg(m, SegFill, 0, NULL, x, w, 0)) {
+			drw_setscheme(drw, scheme[SchemeNorm]);
+			drw_rect(drw, x, 0, w, bh, 1, 1);
+		}
 	}
-	drw_map(drw, m->barwin, 0, 0, m->ww - stw, bh);
+	barend(m);
+	metricsrecord(&drawbarmetrics, start);
 }
 
 
@@ -2255,7 +2482,7 @@ drawclientswitcherwinx(Window win, int ww, int wh)
 		drw_rect(drw, x, y, w, h, 1, 1);
 		int size_level = 1;
 		if(c->icons[size_level]){
-			drw_pic(drw, x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level], c->icws[size_level], c->ichs[size_level], c->icons[size_level]);
+			drawicon(c->icons[size_level], x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level]);
 		}else{
 			drw_text(drw, x+w/2-TEXTW(c->class)/2, y+h/2-bh, TEXTW(c->class), bh, 0, c->class, 0);
 		}
@@ -2325,7 +2552,7 @@ drawclientswitcherwinvertical(Window win, int ww, int wh)
 		drw_rect(drw, x, y, w, h, 1, 1);
 		int size_level = 0;
 		if(c->icons[size_level]){
-			drw_pic(drw, x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level], c->icws[size_level], c->ichs[size_level], c->icons[size_level]);
+			drawicon(c->icons[size_level], x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level]);
 		}else{
 			drw_text(drw, x, y+h/2-bh, w, bh, 30, c->class, 0);
 		}
@@ -2479,6 +2706,12 @@ drawclientswitcherwinverticalsticky(Window win, int ww, int wh)
 		y = itemh * i;
 		w = itemw;
 		h = itemh;
+		i++;
+		unsigned long key = tilemix(tilemix(tilemix(14695981039346656037UL, w), h), c == selmon->sel);
+		key = tilemix(key, c->icons[0] ? c->icons[0]->hash ^ (uintptr_t)c->icons[0] : 0);
+		key = tilemixstr(tilemixstr(key, c->class), c->name);
+		if (tilefetch(&c->stickytile, key, x, y, w, h + 1))
+			continue;
 		if (c == selmon->sel) {
 			drw_setscheme(drw, scheme[SchemeSel]);
 		}else {
@@ -2489,12 +2722,12 @@ drawclientswitcherwinverticalsticky(Window win, int ww, int wh)
 		drw_line(drw, x, y+h, x+w,y+h, 0);
 		int size_level = 0;
 		if(c->icons[size_level]){
-			drw_pic(drw, x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level], c->icws[size_level], c->ichs[size_level], c->icons[size_level]);
+			drawicon(c->icons[size_level], x+w/2-c->icws[size_level]/2, y+h/2-c->ichs[size_level]);
 		}else{
 			drw_text(drw, x, y+h/2-bh, w, bh, 30, c->class, 0);
 		}
 		drw_text(drw, x, y+h/2, w, bh, 30, c->name, 0);
-		i++;
+		tilestore(&c->stickytile, key, x, y, w, h + 1);
 	}
 
 	drw_map(drw,win, 0, 0, ww, wh);
@@ -2629,8 +2862,12 @@ clientswitcheraction(int rx, int ry)
 void
 drawclientswitcherwin(Window win, int ww, int wh)
 {
+	unsigned long long start = metricsnow();
+
 	selmon->switcheraction.drawfuncx(win, ww, wh);
 	drw_map(drw,win, 0, 0, ww, wh);
+	metricsrecord(&drawswitchermetrics, start);
+	metricsframe(isswitcherpreview, start);
 }
 
 
@@ -3002,119 +3239,178 @@ ClientZlevelCmp(const void *a,const void *b)
 }
 
 
-Picture
-getwindowpic(Client *c) {
-  XCompositeRedirectWindow(dpy, c->win, CompositeRedirectAutomatic);
-  XWindowAttributes attr;
-  XGetWindowAttributes( dpy, c->win, &attr );
-  XRenderPictFormat *format = XRenderFindVisualFormat( dpy, attr.visual );
-  int hasAlpha = ( format->type == PictTypeDirect && format->direct.alphaMask );
-  XRenderPictureAttributes pa;
-  pa.subwindow_mode = IncludeInferiors;
-  Picture picture = XRenderCreatePicture( dpy, c->win, format, CPSubwindowMode, &pa );
-  return picture;
-}
-
-
-// 未使用
-XImage*
-getwindowximage(Client *c) {
-  XCompositeRedirectWindow(dpy, c->win, CompositeRedirectAutomatic);
-  XWindowAttributes attr;
-  XGetWindowAttributes( dpy, c->win, &attr );
-  XRenderPictFormat *format = XRenderFindVisualFormat( dpy, attr.visual );
-  int hasAlpha = ( format->type == PictTypeDirect && format->direct.alphaMask );
-  XRenderPictureAttributes pa;
-  pa.subwindow_mode = IncludeInferiors;
-  Picture picture = XRenderCreatePicture( dpy, c->win, format, CPSubwindowMode, &pa );
-  Pixmap pixmap = XCreatePixmap(dpy, root, c->w, c->h, 32);
-  XRenderPictureAttributes pa2;
-  XRenderPictFormat *format2 = XRenderFindStandardFormat(dpy, PictStandardARGB32);
-  Picture pixmapPicture = XRenderCreatePicture( dpy, pixmap, format2, 0, &pa2 );
-  XRenderColor color;
-  color.red = 0x0000;
-  color.green = 0x0000;
-  color.blue = 0x0000;
-  color.alpha = 0x0000;
-  XRenderFillRectangle (dpy, PictOpSrc, pixmapPicture, &color, 0, 0, c->w, c->h);
-  XRenderComposite(dpy, hasAlpha ? PictOpOver : PictOpSrc, picture, 0,
-                   pixmapPicture, 0, 0, 0, 0, 0, 0,
-                   c->w, c->h);
-  XImage* temp = XGetImage( dpy, pixmap, 0, 0, c->w, c->h, AllPlanes, ZPixmap );
-  temp->red_mask = format2->direct.redMask << format2->direct.red;
-  temp->green_mask = format2->direct.greenMask << format2->direct.green;
-  temp->blue_mask = format2->direct.blueMask << format2->direct.blue;
-  temp->depth = DefaultDepth(dpy, screen);
-  XCompositeUnredirectWindow(dpy, c->win, CompositeRedirectAutomatic);
-  return temp;
-}
-
-// 未使用
-XImage*
-scaledownimage(XImage *orig_image, unsigned int cw, unsigned int ch) {
-  int factor_w = orig_image->width / cw + 1;
-  int factor_h = orig_image->height / ch + 1;
-  int scale_factor = factor_w > factor_h ? factor_w : factor_h;
-  int scaled_width = orig_image->width / scale_factor;
-  int scaled_height = orig_image->height / scale_factor;
-  XImage *scaled_image = XCreateImage(dpy, DefaultVisual(dpy, DefaultScreen(dpy)),
-                                      orig_image->depth,
-                                      ZPixmap, 0, NULL,
-                                      scaled_width, scaled_height,
-                                      32, 0);
-  scaled_image->data = malloc(scaled_image->height * scaled_image->bytes_per_line);
-  for (int y = 0; y < scaled_height; y++) {
-      for (int x = 0; x < scaled_width; x++) {
-          int orig_x = x * scale_factor;
-          int orig_y = y * scale_factor;
-          unsigned long pixel = XGetPixel(orig_image, orig_x, orig_y);
-          XPutPixel(scaled_image, x, y, pixel);
-      }
-  }
-  scaled_image->depth = orig_image->depth;
-  return scaled_image;
-}
-
-void
-set_backgroud(Client *c, int minlastfocusperiod, int maxlastfocusperiod, int minlastfocustime, int maxlastfocustime){
+/* the switcher background of c, shaded by how recently and how long it had
+ * the focus.  the shade moves on the scale of minutes, so it is worked out
+ * again at most once a second unless its inputs change */
+Clr *
+switcherbg(Client *c, long minlastfocusperiod, long maxlastfocusperiod, long minlastfocustime)
+{
+	unsigned long key;
+	long curr;
+
 	if (c == selmon->sel)
+		return scheme[SchemeSel];
+	if (isswitcherpreview)
+		return scheme[SchemeNorm];
+	curr = getcurrusec();
+	key = tilemix(tilemix(tilemix(tilemix(tilemix(14695981039346656037UL,
+		minlastfocusperiod), maxlastfocusperiod), minlastfocustime),
+		c->lastfocustime), c->lastunfocustime);
+	if (c->tilebg && c->tilebgkey == key && curr - c->tilebgtime < 1000000)
+		return c->tilebg;
+	c->tilebgkey = key;
+	c->tilebgtime = curr;
+	c->tilebg = scheme[SchemeNorm];
+
+	long lastfocusperiod = c->lastunfocustime - c->lastfocustime;
+	if(lastfocusperiod > 0 
+		&& lastfocusperiod > minlastfocusperiod 
+		&& maxlastfocusperiod - minlastfocusperiod > 0 
+		&& curr - minlastfocustime > 0 
+		&& c->lastfocustime - minlastfocustime > 0){
+		int timescale = 1000 * 1000 * 60;
+		// 归一化
+		float focusperiodfeat = 1.0 * log(1.0*(lastfocusperiod - minlastfocusperiod)/timescale + 1)/log(1.0*(maxlastfocusperiod - minlastfocusperiod)/timescale+ 1);
+		// 归一化后反比
+		float focustimefeat = (exp(5.0 * log(1.0*(c->lastfocustime - minlastfocustime)/timescale + 1) / log(1.0*(curr - minlastfocustime)/timescale + 1)) - 1) / (exp(5.0) - 1);
+		if(focustimefeat <= 0) return c->tilebg;
+		float feat = pow(focustimefeat * focusperiodfeat, 0.5);
+		int clr_level = 0.99 * gradual_colors_count * feat;
+		if(clr_level >= LENGTH(gradual_colors)) return c->tilebg;
+		LOG_FORMAT("lastfocusperiod:%ld %ld %ld %d",lastfocusperiod,minlastfocusperiod,maxlastfocusperiod,clr_level);
+		c->tilebg = gradual_scheme[clr_level];
+	}
+	return c->tilebg;
+}
+
+/* one client of the tag switcher, at x, y and one pixel more than w x h */
+static void
+drawswitchertile(Client *c, int x, int y, int w, int h, Clr *bg, Picture pic, Client *lastfocused)
+{
+	if (c->isdoublepagemarked)
 	{
 		drw_setscheme(drw, scheme[SchemeSel]);
+		drw_rect(drw, x, y, w, h, 1, 1);
+		x = x + 1;
+		y = y + 1;
+		w = w - 2;
+		h = h - 2;
+	}
+	drw_setscheme(drw, bg);
+	drw_rect(drw, x, y, w, h, 1, 1);
+
+	if(isswitcherpreview){
+		// preview
+		if (pic)
+			drw_pic(drw, x, y, w, h, pic);
+		if(c == selmon->sel){
+			int lw = w/24 * 2;
+			int lh = h/24;
+			drw_rect(drw, x, y, lw, lh, 1, 1); // 竖
+			drw_rect(drw, x, y, lh, lw, 1, 1); // 横
+			drw_rect(drw, x+w-lw, y, lw, lh, 1, 1); // 竖
+			drw_rect(drw, x+w-lh, y, lh, lw, 1, 1); // 横
+			drw_rect(drw, x, y+h-lh, lw, lh, 1, 1); // 竖
+			drw_rect(drw, x, y+h-lw, lh, lw, 1, 1); // 横
+			drw_rect(drw, x+w-lw, y+h-lh, lw, lh, 1, 1); // 竖
+			drw_rect(drw, x+w-lh, y+h-lw, lh, lw, 1, 1); // 横
+		}
+	}
+
+	int size_level = 1;
+	if (c->ichs[size_level] > h/2) {
+		size_level = 0;
+	}
+	if (c->icons[size_level])
+	{
+		drawicon(c->icons[size_level], x + w / 2 - c->icws[size_level] / 2, y + h / 2 - c->ichs[size_level]);
 	}
 	else
 	{
-		// drw_setscheme(drw, scheme[SchemeNorm]);
-		// return;
+		int tw = MIN(TEXTW(c->class), w);
+		int th = bh;
+		if(h / 2 < th) th = h / 2;
+		drw_text_x(drw, x + w / 2 - tw / 2, y + h / 2 - th, tw, th, 0, c->class, 0, 0);
+	}
+
+	int th = bh;
+	int tw = w;
+	tw = MIN(TEXTW(c->name), w);
+	th = MIN(th, h / 4);
+
+	if (isswitcherpreview){
+		// ----- preview 相关修改
+		drw_setscheme(drw, bg);
+		drw_rect(drw, x , y + h - th, w, th, 1, 1);
+		drw_text(drw, x + w/2 - tw/2, y + h - th, tw, th, 2, c->name, 0);
+		// -----
+	}else{
+		drw_text(drw, x + w/2 - tw/2, y + 2 * h / 4, tw, th, 2, c->name, 0);
+	}
+
+	if(strlen(c->note) > 0){
+		tw = MIN(TEXTW(c->note), w);
+		th = MIN(th, h / 4);
+		drw_text(drw, x + w/2 - tw/2, y + 3 * h / 4, tw, th, 2, c->note, 0);
+	}
+
+	if(strlen(c->shortcut) > 0){
+		tw = MIN(TEXTW(c->shortcut), w);
+		th = MIN(th, h / 4);
+		if(h / 2 < th) th = h / 2;
+
+		drw_setscheme(drw, bg);
 		if(isswitcherpreview){
-			// preview
-			drw_setscheme(drw, scheme[SchemeNorm]);
-			return;
-		}
-		long lastfocusperiod = c->lastunfocustime - c->lastfocustime;
-		long curr = getcurrusec();
-		if(lastfocusperiod > 0 
-			&& lastfocusperiod > minlastfocusperiod 
-			&& maxlastfocusperiod - minlastfocusperiod > 0 
-			&& curr - minlastfocustime > 0 
-			&& c->lastfocustime - minlastfocustime > 0){
-			LOG_FORMAT("lastfocusperiod1:%ld %ld %ld %ld",lastfocusperiod,minlastfocusperiod,maxlastfocusperiod,c->lastfocustime);
-			int timescale = 1000 * 1000 * 60;
-			// 归一化
-			float focusperiodfeat = 1.0 * log(1.0*(lastfocusperiod - minlastfocusperiod)/timescale + 1)/log(1.0*(maxlastfocusperiod - minlastfocusperiod)/timescale+ 1);
-			// 归一化后反比
-			float focustimefeat = (exp(5.0 * log(1.0*(c->lastfocustime - minlastfocustime)/timescale + 1) / log(1.0*(curr - minlastfocustime)/timescale + 1)) - 1) / (exp(5.0) - 1);
-			if(focustimefeat <= 0) return;
-			float feat = pow(focustimefeat * focusperiodfeat, 0.5);
-			int clr_level = 0.99 * gradual_colors_count * feat;
-			if(clr_level >= LENGTH(gradual_colors)) return;
-			LOG_FORMAT("lastfocusperiod:%ld %ld %ld %d",lastfocusperiod,minlastfocusperiod,maxlastfocusperiod,clr_level);
-			LOG_FORMAT("lastfocusperiod:%f",focusperiodfeat);
-			LOG_FORMAT("lastfocusperiod:%f",focustimefeat);
-			drw_setscheme(drw, gradual_scheme[clr_level]);
+			// ----- preview 相关修改
+			drw_rect(drw, x, y + h  - 2*th, w, th, 1, 1);
+			drw_text(drw, x + 32, y + h - 2*th, tw, th, 0, c->shortcut, 0);
+			// -----
 		}else{
-			drw_setscheme(drw, scheme[SchemeNorm]);
+			drw_text(drw, x + 32, y + h / 2 - th, tw, th, 0, c->shortcut, 0);
 		}
 	}
+
+	Clr *oldscheme  = drw->scheme;
+	if(c->container->arrange == container_layout_full && c->container->cn > 1){
+		drw_setscheme(drw, scheme[SchemeFulled]);
+	}
+
+	drw_line(drw, x, y, x+w,y, 0);
+	drw_line(drw, x, y+h, x+w, y+h, 0);
+	drw_line(drw, x, y, x,y+h, 0);
+	drw_line(drw, x+w, y, x+w,y+h, 0);
+	
+	if(lastfocused && lastfocused == c)
+	{
+		drw_setscheme(drw, scheme[SchemeWarn]);
+		/* kept inside the tile */
+		drw_text_x(drw, x + w / 2, y + h - th, MIN(tw, w - w / 2), th, 0, "▲", 0, 0);
+	}
+
+	drw_setscheme(drw, oldscheme);
+}
+
+/* what drawswitchertile() would draw */
+static unsigned long
+switchertilekey(Client *c, int w, int h, Clr *bg, Picture pic, Client *lastfocused)
+{
+	unsigned long k = 14695981039346656037UL;
+	int i;
+
+	k = tilemix(k, w);
+	k = tilemix(k, h);
+	k = tilemix(k, isswitcherpreview); /* lays the tile out differently */
+	k = tilemix(k, (uintptr_t)bg);
+	k = tilemix(k, (c == selmon->sel) | c->isdoublepagemarked << 1 | (c == lastfocused) << 2
+		| (c->container->arrange == container_layout_full && c->container->cn > 1) << 3);
+	k = tilemix(k, pic);
+	k = tilemix(k, c->previewgen);
+	for (i = 0; i < 2; i++)
+		k = tilemix(k, c->icons[i] ? c->icons[i]->hash ^ (uintptr_t)c->icons[i] : 0);
+	k = tilemixstr(k, c->name);
+	k = tilemixstr(k, c->class);
+	k = tilemixstr(k, c->note);
+	return tilemixstr(k, c->shortcut);
 }
 
 void drawclientswitcherwinx_pretag(Window win, int tagindex, int tagsx, int tagsy, int tagsww, int tagswh)
@@ -3129,9 +3425,6 @@ void drawclientswitcherwinx_pretag(Window win, int tagindex, int tagsx, int tags
 	}
 
 	unsigned int tags = 1<<tagindex;
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	drw_rect(drw, tagsx, tagsy, tagsww, tagswh, 1, 1);
-
 	Client *c;
 	int n = 0;
 	for (c = selmon->clients; c; c = c->next)
@@ -3140,7 +3433,11 @@ void drawclientswitcherwinx_pretag(Window win, int tagindex, int tagsx, int tags
 			continue;
 		n++;
 	}
-	if(n == 0) return;
+	if(n == 0) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_rect(drw, tagsx, tagsy, tagsww, tagswh, 1, 1);
+		return;
+	}
 	Client *cs[n];
 	XY cxys[n];
 	XY cxyse[n];
@@ -3172,7 +3469,6 @@ void drawclientswitcherwinx_pretag(Window win, int tagindex, int tagsx, int tags
 	clientxy2switcherxy_pertag_one(cxyse, n, sxyse,s2t, tagindex, tagsx, tagsy, tagsww, tagswh);
 	long minlastfocusperiod = LONG_MAX;
 	long maxlastfocusperiod = LONG_MIN;
-	long maxlastfocustime = LONG_MIN;
 	long minlastfocustime = LONG_MAX;
 	for (i = 0; i<n; i++)
 	{
@@ -3196,128 +3492,47 @@ void drawclientswitcherwinx_pretag(Window win, int tagindex, int tagsx, int tags
 		c = cs[i];
 		long  lastfocustime = c->lastfocustime;
 		if(lastfocustime == 0) continue;
-		maxlastfocustime = MAX(maxlastfocustime, lastfocustime);
 		minlastfocustime = MIN(minlastfocustime, lastfocustime);
 	}
+
+	/* the keys first: if none changed the whole tag is copied */
+	Clr *bgs[n];
+	Picture pics[n];
+	unsigned long keys[n];
+	unsigned long tagkey = tilemix(tilemix(tilemix(14695981039346656037UL, tagsww), tagswh),
+		isswitcherpreview);
 	for (i = 0; i<n; i++)
 	{
 		c = cs[i];
-		int x, y, w, h;
-		x = sxys[i].x;
-		y = sxys[i].y;
-		w = sxyse[i].x - sxys[i].x;
-		h = sxyse[i].y - sxys[i].y;
-		if (c->isdoublepagemarked)
-		{
-			drw_setscheme(drw, scheme[SchemeSel]);
-			drw_rect(drw, x, y, w, h, 1, 1);
-			x = x + 1;
-			y = y + 1;
-			w = w - 2;
-			h = h - 2;
-		}
-		set_backgroud(c, minlastfocusperiod, maxlastfocusperiod, minlastfocustime, maxlastfocustime);
-		drw_rect(drw, x, y, w, h, 1, 1);
-
-		if(isswitcherpreview){
-			// preview
-			Picture pic = getwindowpic(c);
-			drw_pic(drw, x, y, w, h, drw_resize_picture(drw, pic, c->w, c->h,  w, h));
-			// drw_pic(drw, x, y, w, h, drw_blur_picture(drw, pic, c->w, c->h,  w, h));
-			if(c == selmon->sel){
-				int lw = w/24 * 2;
-				int lh = h/24;
-				drw_rect(drw, x, y, lw, lh, 1, 1); // 竖
-				drw_rect(drw, x, y, lh, lw, 1, 1); // 横
-				drw_rect(drw, x+w-lw, y, lw, lh, 1, 1); // 竖
-				drw_rect(drw, x+w-lh, y, lh, lw, 1, 1); // 横
-				drw_rect(drw, x, y+h-lh, lw, lh, 1, 1); // 竖
-				drw_rect(drw, x, y+h-lw, lh, lw, 1, 1); // 横
-				drw_rect(drw, x+w-lw, y+h-lh, lw, lh, 1, 1); // 竖
-				drw_rect(drw, x+w-lh, y+h-lw, lh, lw, 1, 1); // 横
-			}
-			XRenderFreePicture(dpy, pic);
-		}
-
-		int size_level = 1;
-		if (c->ichs[size_level] > h/2) {
-			size_level = 0;
-		}
-		if (c->icons[size_level])
-		{
-			drw_pic(drw, x + w / 2 - c->icws[size_level] / 2, y + h / 2 - c->ichs[size_level], c->icws[size_level], c->ichs[size_level], c->icons[size_level]);
-			// thumb
-			// if(c->thumb)
-			// 	drw_pic(drw, x + w / 2 - c->icws[size_level] / 2, y + h / 2 - c->ichs[size_level], c->icws[size_level], c->ichs[size_level], c->thumb);
-		}
-		else
-		{
-			int tw = MIN(TEXTW(c->class), w);
-			int th = bh;
-			if(h / 2 < th) th = h / 2;
-			drw_text_x(drw, x + w / 2 - tw / 2, y + h / 2 - th, tw, th, 0, c->class, 0, 0);
-		}
-
-
-
-		int th = bh;
-		int tw = w;
-		tw = MIN(TEXTW(c->name), w);
-		th = MIN(th, h / 4);
-		tw = MIN(TEXTW(c->name), w);
-		th = MIN(th, h / 4);
-
-		if (isswitcherpreview){
-			// ----- preview 相关修改
-			set_backgroud(c, minlastfocusperiod, maxlastfocusperiod, minlastfocustime, maxlastfocustime);
-			drw_rect(drw, x , y + h - th, w, th, 1, 1);
-			drw_text(drw, x + w/2 - tw/2, y + h - th, tw, th, 2, c->name, 0);
-			// -----
-		}else{
-			drw_text(drw, x + w/2 - tw/2, y + 2 * h / 4, tw, th, 2, c->name, 0);
-		}
-
-		if(strlen(c->note) > 0){
-			tw = MIN(TEXTW(c->note), w);
-			th = MIN(th, h / 4);
-			drw_text(drw, x + w/2 - tw/2, y + 3 * h / 4, tw, th, 2, c->note, 0);
-		}
-
-		if(strlen(c->shortcut) > 0){
-			tw = MIN(TEXTW(c->shortcut), w);
-			th = MIN(th, h / 4);
-			if(h / 2 < th) th = h / 2;
-
-			set_backgroud(c, minlastfocusperiod, maxlastfocusperiod, minlastfocustime, maxlastfocustime);
-			if(isswitcherpreview){
-				// ----- preview 相关修改
-				drw_rect(drw, x, y + h  - 2*th, w, th, 1, 1);
-				drw_text(drw, x + 32, y + h - 2*th, tw, th, 0, c->shortcut, 0);
-				// -----
-			}else{
-				drw_text(drw, x + 32, y + h / 2 - th, tw, th, 0, c->shortcut, 0);
-			}
-		}
-
-
-		Clr *oldscheme  = drw->scheme;
-		if(c->container->arrange == container_layout_full && c->container->cn > 1){
-			drw_setscheme(drw, scheme[SchemeFulled]);
-		}
-
-		drw_line(drw, x, y, x+w,y, 0);
-		drw_line(drw, x, y+h, x+w, y+h, 0);
-		drw_line(drw, x, y, x,y+h, 0);
-		drw_line(drw, x+w, y, x+w,y+h, 0);
-		
-		if(lastfocused && lastfocused == c)
-		{
-			drw_setscheme(drw, scheme[SchemeWarn]);
-			drw_text_x(drw, x + w / 2, y + h - th, tw, th, 0, "▲", 0, 0);
+		int w = sxyse[i].x - sxys[i].x;
+		int h = sxyse[i].y - sxys[i].y;
+		if (c->isdoublepagemarked) {
+			w -= 2;
+			h -= 2;
 		}
+		bgs[i] = switcherbg(c, minlastfocusperiod, maxlastfocusperiod, minlastfocustime);
+		pics[i] = isswitcherpreview ? previewget(c, w, h) : None;
+		keys[i] = switchertilekey(c, w, h, bgs[i], pics[i], lastfocused);
+		tagkey = tilemix(tilemix(tilemix(tagkey, keys[i]), sxys[i].x - tagsx), sxys[i].y - tagsy);
+	}
+	if (tilefetch(&selmon->tagtiles[tagindex], tagkey, tagsx, tagsy, tagsww, tagswh))
+		return;
 
-		drw_setscheme(drw, oldscheme);
+	drw_setscheme(drw, scheme[SchemeNorm]);
+	drw_rect(drw, tagsx, tagsy, tagsww, tagswh, 1, 1);
+	for (i = 0; i<n; i++)
+	{
+		c = cs[i];
+		int x = sxys[i].x;
+		int y = sxys[i].y;
+		int w = sxyse[i].x - sxys[i].x;
+		int h = sxyse[i].y - sxys[i].y;
+		if (tilefetch(&c->tile, keys[i], x, y, w + 1, h + 1))
+			continue;
+		drawswitchertile(c, x, y, w, h, bgs[i], pics[i], lastfocused);
+		tilestore(&c->tile, keys[i], x, y, w + 1, h + 1);
 	}
+	tilestore(&selmon->tagtiles[tagindex], tagkey, tagsx, tagsy, tagsww, tagswh);
 }
 
 void drawclientswitcherwinx_tag(Window win, int ww, int wh)
@@ -4472,6 +4687,14 @@ toggleswitchers(const Arg *arg)
 	}
 }
 
+void
+toggleswitcherpreview(const Arg *arg)
+{
+	isswitcherpreview = !isswitcherpreview;
+	if (selmon->switcher)
+		markdirty(selmon, DirtySwitcher);
+}
+
 void
 toggleswitchersticky(const Arg *arg)
 {
@@ -4566,6 +4789,8 @@ enqueue(Client *c)
 	if (l) {
 		l->next = c;
 		c->next = NULL;
+		c->attached = 1;
+		tagstatecount(c, 1);
 	}
 }
 
@@ -4664,7 +4889,9 @@ expose(XEvent *e)
 	XExposeEvent *ev = &e->xexpose;
 
 	if (ev->count == 0 && (m = wintomon(ev->window))) {
-		drawbar(m);
+		if (ev->window == m->barwin)
+			barinvalidate(m);
+		markdirty(m, DirtyBar);
 		if (m == selmon)
 			updatesystray();
 	}
@@ -4721,7 +4948,7 @@ focus(Client *c)
 		LOG_FORMAT("focus: c or c->win is NULL");
 		// return;
 	}
-	drawbars();
+	markdirty(NULL, DirtyBar);
 	LOG_FORMAT("focus: over");
 
 	// if(c){
@@ -5357,7 +5584,7 @@ getwinatomprop(Window win, Atom prop)
 	if (prop == xatom[XembedInfo])
 		req = xatom[XembedInfo];
 
-	if (XGetWindowProperty(dpy, win, prop, 0L, sizeof atom, False, req,
+	if (getprop(win, prop, sizeof atom, req,
 		&da, &di, &dl, &dl, &p) == Success && p) {
 		atom = *(Atom *)p;
 		if (da == xatom[XembedInfo] && dl == 2)
@@ -5374,30 +5601,6 @@ getatomprop(Client *c, Atom prop)
 }
 
 
-pid_t
-getstatusbarpid()
-{
-	char buf[32], *str = buf, *c;
-	FILE *fp;
-
-	if (statuspid > 0) {
-		snprintf(buf, sizeof(buf), "/proc/%u/cmdline", statuspid);
-		if ((fp = fopen(buf, "r"))) {
-			fgets(buf, sizeof(buf), fp);
-			while ((c = strchr(str, '/')))
-				str = c + 1;
-			fclose(fp);
-			if (!strcmp(str, STATUSBAR))
-				return statuspid;
-		}
-	}
-	if (!(fp = popen("pidof -s "STATUSBAR, "r")))
-		return -1;
-	fgets(buf, sizeof(buf), fp);
-	pclose(fp);
-	return strtol(buf, NULL, 10);
-}
-
 int
 getwindowptr(int *x, int *y, Window win)
 {
@@ -5405,6 +5608,7 @@ getwindowptr(int *x, int *y, Window win)
 	unsigned int dui;
 	Window dummy;
 
+	roundtrips++;
 	return XQueryPointer(dpy, win, &dummy, &dummy,&di, &di, x, y, &dui);
 }
 
@@ -5415,6 +5619,7 @@ getrootptr(int *x, int *y)
 	unsigned int dui;
 	Window dummy;
 
+	roundtrips++;
 	return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
@@ -5427,7 +5632,7 @@ getstate(Window w)
 	unsigned long n, extra;
 	Atom real;
 
-	if (XGetWindowProperty(dpy, w, wmatom[WMState], 0L, 2L, False, wmatom[WMState],
+	if (getprop(w, wmatom[WMState], 2L, wmatom[WMState],
 		&real, &format, &n, &extra, (unsigned char **)&p) != Success)
 		return -1;
 	if (n != 0)
@@ -5458,8 +5663,12 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	if (!text || size == 0)
 		return 0;
 	text[0] = '\0';
-	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
+	if (!proptext(w, atom, &name))
+		return 0;
+	if (!name.nitems) {
+		XFree(name.value);
 		return 0;
+	}
 	if (name.encoding == XA_STRING)
 		strncpy(text, (char *)name.value, size - 1);
 	else {
@@ -5517,13 +5726,30 @@ handlexevent(struct epoll_event *ev)
 {
 	if (ev->events & EPOLLIN) {
 		XEvent ev;
-		while (running && XPending(dpy)) {
-			XNextEvent(dpy, &ev);
-			if (handler[ev.type]) {
-				handler[ev.type](&ev); /* call handler */
-				ipc_send_events(mons, &lastselmon, selmon);
+		unsigned long long start, batchstart = metricsnow();
+		deferring = 1;
+		do {
+			while (running && XPending(dpy)) {
+				XNextEvent(dpy, &ev);
+				if (damageevent >= 0 && ev.type == damageevent + XDamageNotify) {
+					damagenotify(&ev);
+				} else if (ev.type < LASTEvent && handler[ev.type]) {
+					start = metricsnow();
+					/* input handlers hit-test bar and window geometry */
+					if (ev.type == KeyPress || ev.type == KeyRelease
+					|| ev.type == ButtonPress || ev.type == MotionNotify)
+						flushdirty();
+					handler[ev.type](&ev); /* call handler */
+					metricsevent(ev.type, start);
+				}
 			}
-		}
+			flushdirty();
+			/* events read while flushing would not wake epoll again */
+		} while (running && XQLength(dpy));
+		deferring = 0;
+		/* subscribers only see the state the batch ended in */
+		ipc_send_events(mons, &lastselmon, selmon);
+		metricsrecord(&batchmetrics, batchstart);
 	} else if (ev-> events & EPOLLHUP) {
 		return -1;
 	}
@@ -5774,7 +6000,7 @@ getwinrule(Window win)
 	const char *class, *instance;
 	
 	XClassHint ch = { NULL, NULL };
-	XGetClassHint(dpy, win, &ch);
+	propclasshint(win, &ch);
 	class    = ch.res_class ? ch.res_class : broken;
 	instance = ch.res_name  ? ch.res_name  : broken;
 
@@ -5806,7 +6032,7 @@ getwindowpid(Window w)
 	unsigned long  bytesAfter;
 	unsigned char *propPID = 0;
 	unsigned long pid;
-	if(Success == XGetWindowProperty(dpy, w, netatom[NetWmPid], 0, 1, False, XA_CARDINAL,
+	if(Success == getprop(w, netatom[NetWmPid], 1, XA_CARDINAL,
 										&type, &format, &nItems, &bytesAfter, &propPID))
 	{
 		if(propPID){
@@ -5822,26 +6048,7 @@ getwindowpid(Window w)
 
 unsigned long getppidof(unsigned long pid)
 {
-  char dir[1024]={0};
-  char path[1024] = {0};
-  char buf[1024] = {0};
-  int rpid = 0;
-  unsigned long fpid=0;
-  char fpth[1024]={0};
-  ssize_t ret =0;
-  sprintf(dir,"/proc/%ld/",pid);
-  sprintf(path,"%sstat",dir);
-	struct stat st;
-	if(stat(path,&st)!=0)
-    return 0; 
-  memset(buf,0,strlen(buf));
-  FILE * fp = fopen(path,"r");
-	if(!fp) return 0;
-  ret += fread(buf + ret,1,300-ret,fp);
-  fclose(fp);
-  sscanf(buf,"%*d %*c%s %*c %d %*s",fpth,&fpid);
-  fpth[strlen(fpth)-1]='\0';
-  return fpid;
+	return procppid(pid);
 }
 
 void
@@ -5886,7 +6093,7 @@ manageppidstick(Client *c){
 		Rule * rule = getwinrule(c->win);
 		if (!rule->isfloating)
 		{
-			c->tags = tmpparent->tags;
+			setclienttags(c, tmpparent->tags);
 			Arg arg = {.ui= tmpparent->tags };
 			view(&arg);
 			return 1;
@@ -5918,7 +6125,7 @@ managestub(Client *c){
 			while (counttagnstub(selmon->clients, tmptags) >= (3 - rule->nstub))
 				tmptags = tmptags << 1;
 			LOG_FORMAT("managestub 5");
-			c->tags = tmptags;
+			setclienttags(c, tmptags);
 			Arg arg = {.ui= tmptags };
 			view(&arg);
 			if (rule->nstub == 2 && selmon->sellt == 0)
@@ -6044,8 +6251,16 @@ manage(Window w, XWindowAttributes *wa)
 	Window trans = None;
 	XWindowChanges wc;
 
+	/* everything the update* helpers and the rules below read, in one go */
+	Atom fetch[] = { wmatom[WMState], netatom[NetWMIcon], netatom[NetWMName], XA_WM_NAME,
+		XA_WM_CLASS, netatom[NetMyNote], XA_WM_TRANSIENT_FOR, netatom[NetWMState],
+		netatom[NetWMWindowType], XA_WM_NORMAL_HINTS, XA_WM_HINTS, netatom[NetWmPid],
+		netatom[NetWMBypassCompositor] };
+	propprefetch(w, fetch, LENGTH(fetch));
+
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
+	c->state = getstate(w);
 	/* geometry */
 	c->x = c->oldx = wa->x;
 	c->y = c->oldy = wa->y;
@@ -6093,16 +6308,15 @@ manage(Window w, XWindowAttributes *wa)
 	 } else c->istemp = 0;
 
 
-	updateicon(c);
-	updateicons(c);
+	updateiconset(c);
 	updatetitle(c);
 	updateclass(c);
 	updatenote(c);
 
 	LOG_FORMAT("manage 1");
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	if (proptransient(w, &trans) && (t = wintoclient(trans))) {
 		c->mon = t->mon;
-		c->tags = t->tags;
+		setclienttags(c, t->tags);
 		c->nstub = 0;
 	} else {
 		c->mon = selmon;
@@ -6114,6 +6328,7 @@ manage(Window w, XWindowAttributes *wa)
 	updatewindowtype(c);
 	updatesizehints(c);
 	updatewmhints(c);
+	updatebypass(c);
 
 	if (c->istemp)
 	{
@@ -6148,8 +6363,10 @@ manage(Window w, XWindowAttributes *wa)
 		ispawnpids[0] = 0;
 		ispawntimes[0] = 0;
 	}else{
-		if(selmon->sel)
+		if(selmon->sel) {
 			c->container->launchparent = selmon->sel->container;
+			placementinvalidate();
+		}
 		if (isrispawn) {
 			// 替换, FIXME, 多个refc确定替换哪个
 			// replacercincontainer(c, oldc->containerrefc);
@@ -6192,7 +6409,7 @@ manage(Window w, XWindowAttributes *wa)
 
 	LOG_FORMAT("manage 3");
 	if(!manageppidstick(c) && !isnextscratch && !isnexttemp) managestub(c);
-	if((selmon->tagset[selmon->seltags] & TAGMASK == TAGMASK) && (c->tags & TAGMASK) == TAGMASK) c->tags = 1; 
+	if((selmon->tagset[selmon->seltags] & TAGMASK == TAGMASK) && (c->tags & TAGMASK) == TAGMASK) setclienttags(c, 1);
 	LOG_FORMAT("manage 4");
 
 	if (c->x + WIDTH(c) > c->mon->mx + c->mon->mw)
@@ -6214,7 +6431,7 @@ manage(Window w, XWindowAttributes *wa)
 	if (c->istemp && !isnextscratch)
 	{
 		if (!isispawn) {
-			c->tags = TAGMASK;
+			setclienttags(c, TAGMASK);
 		}
 		c->w = c->mon->ww / 2.5;
 		c->h = c->mon->wh / 2;
@@ -6225,7 +6442,7 @@ manage(Window w, XWindowAttributes *wa)
 	if (c->issidecar)
 	{
 		if (!isispawn) {
-			c->tags = TAGMASK;
+			setclienttags(c, TAGMASK);
 		}
 		c->w = c->mon->ww * 0.4;
 		c->h = c->mon->wh;
@@ -6235,7 +6452,8 @@ manage(Window w, XWindowAttributes *wa)
 	
 	selmon->tagset[selmon->seltags] &= ~scratchtag;
 	if (!strcmp(c->name, scratchpadname)) {
-		c->mon->tagset[c->mon->seltags] |= c->tags = scratchtag;
+		setclienttags(c, scratchtag);
+		c->mon->tagset[c->mon->seltags] |= c->tags;
 		c->x = c->mon->wx + (c->mon->ww / 2 - WIDTH(c) / 2);
 		c->y = c->mon->wy + (c->mon->wh / 2 - HEIGHT(c) / 2);
 	}
@@ -6247,6 +6465,8 @@ manage(Window w, XWindowAttributes *wa)
 	configure(c); /* propagates border_width, if size doesn't change */
 	
 	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+	/* from here on changes are reported, read them fresh */
+	propdrop();
 	grabbuttons(c, 0);
 	// if (!c->isfloating)
 	// 	c->isfloating = c->oldstate = trans != None || c->isfixed;
@@ -6259,6 +6479,7 @@ manage(Window w, XWindowAttributes *wa)
 	}	
 	attach(c);
 	attachstack(c);
+	wintableadd(clienttable, LENGTH(clienttable), c);
 
 	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
 		(unsigned char *) &(c->win), 1);
@@ -6274,7 +6495,7 @@ manage(Window w, XWindowAttributes *wa)
 		ScratchItem* si = _addtoscratchgroupc(c, 0);
 		if(!c->istemp) 
 			showscratchgroup(scratchgroupptr);
-		c->tags = curtags;
+		setclienttags(c, curtags);
 		isnextscratch = 0;
 		// si->pretags = 1 << (LENGTH(tags) - 1);
 		si->pretags = c->tags;  // 隐藏scratch的时候会回到pretags, 之前设置的是最后一个tag, 但是现在可以隐藏窗口, 所以这里直接回到当前的tag就可以了
@@ -6288,7 +6509,10 @@ manage(Window w, XWindowAttributes *wa)
 		hide(c);
 	}else{
 		arrange(c->mon);
-		XMapWindow(dpy, c->win);
+		if (c->tagunmapped)
+			c->ignoreunmap = 0; /* not mapped yet, tagunmap() had nothing to unmap */
+		else
+			XMapWindow(dpy, c->win);
 		XRaiseWindow(dpy,c->win);
 		focus(c);
 		XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w /2, c->h /2);
@@ -6333,6 +6557,7 @@ maprequest(XEvent *e)
 		updatesystray();
 	}
 
+	roundtrips++;
 	if (!XGetWindowAttributes(dpy, ev->window, &wa))
 		return;
 	if (wa.override_redirect)
@@ -6455,8 +6680,8 @@ void doublepagemarkclient(Client *c){
 		unsigned int targettag = 1 << 7;
 		topcpretags[0] = topcs[0]->tags;
 		topcpretags[1] = topcs[1]->tags;
-		topcs[0]->tags = targettag;
-		topcs[1]->tags = targettag;
+		setclienttags(topcs[0], targettag);
+		setclienttags(topcs[1], targettag);
 		topcs[0]->isdoublepagemarked = 0;
 		topcs[1]->isdoublepagemarked = 0;
 		Arg viewarg = {.ui = targettag};
@@ -6481,8 +6706,8 @@ void cleardoublepage(int v){
 	if(!doubled) return;
 	if (topcs[0] && topcpretags[0] && topcs[1] && topcpretags[1])
 	{
-		topcs[0]->tags = topcpretags[0];
-		topcs[1]->tags = topcpretags[1];
+		setclienttags(topcs[0], topcpretags[0]);
+		setclienttags(topcs[1], topcpretags[1]);
 		topcs[0]->isdoublepagemarked = 0;
 		topcs[1]->isdoublepagemarked = 0;
 		topcs[0]->isdoubled = 0;
@@ -6589,19 +6814,9 @@ motionnotify(XEvent *e)
 	mon = m;
 
 	if(ev->y >selmon->by && ev->y < selmon->by + bh){
-		int x = 0, i = 0;
-		Client *c;
-		unsigned int occ = 0;
-		for(c = m->clients; c; c=c->next)
-			occ |= c->tags;
-		do {
-			/* Do not reserve space for vacant tags */
-			if (!(occ & 1 << i || m->tagset[m->seltags] & 1 << i))
-				continue;
-			x += TEXTW(tags[i]);
-		} while (ev->x >= x && ++i < LENGTH(tags));
-		if (i < LENGTH(tags) && 1 << i != selmon->tagset[selmon->seltags]) {
-			const Arg arg = {.ui = 1 << i};
+		BarSeg *seg = barsegat(selmon, ev->x);
+		if (seg && seg->kind == SegTag && 1 << seg->index != selmon->tagset[selmon->seltags]) {
+			const Arg arg = {.ui = 1 << seg->index};
 			view(&arg);
 		}else{
 			// 鼠标移动到标题栏 出现switcher
@@ -6609,19 +6824,6 @@ motionnotify(XEvent *e)
 			// todo
 			/*}*/
 
-			x += blw;
-
-			for(i = 0; i < LENGTH(launchers); i++) {
-				x += TEXTW(launchers[i].name);
-			}
-
-			Client *vc;
-			for (vc = selmon->clients; vc; vc = vc->next) {
-				if (ISVISIBLE(vc)) {
-					x += vc->titlew;
-				}
-			}
-
 			// 鼠标移动到标题栏空白处, 出现rofi
 			/*if(ev->x > x && ev->x < selmon->ww - statusw - getsystraywidth()){*/
 				/*char offsetx[5];*/
@@ -6724,51 +6926,6 @@ spiralplace(Container *containers[], int n, MXY targetpos[])
 	}
 }
 
-int
-pyplace(int targetindex[], int n, MXY targetpos[], int clientids[])
-{
-	if(n==0) return 0;
-	int i;
-	char *url = "http://localhost:8666/place";
-	char params[3000];
-	memset(params, 0, sizeof(params));
-
-	strcat(params, "tag=");
-	char tag[2];
-	sprintf(tag, "%d", getcurtagindex(selmon));
-	strcat(params, tag);
-	strcat(params, "&");
-	strcat(params, "targets=");
-	for(i=0;i<n;i++)
-	{
-		char str[20];
-		sprintf(str, "%d|%d|%d|%d", targetindex[i], targetpos[i].row, targetpos[i].col, clientids[i]);
-		strcat(params, str);
-		if(i!=n-1)
-			strcat(params, ",");
-	}
-
-	struct HttpResponse resp;
-	resp.content = malloc(1);
-	resp.size = 0;
-	resp.code = CURLE_OK;
-	int ok = httppost(url,params, &resp);
-	if (!ok) return 0;
-
-	/*int j = 0;*/
-	/*char *temp = strtok(resp.content,",");*/
-	/*while(temp)*/
-	/*{*/
-		/*[>LOG_FORMAT("pyresort2 %s", temp);<]*/
-		/*sscanf(temp,"%d",&resorted[j]);*/
-		/*j++;*/
-		/*temp = strtok(NULL,",");*/
-	/*}*/
-	free(resp.content);
-	return 1;
-}
-
-
 // 实际坐标转化为spiral 布局中的以中间为中心的坐标
 /**
  * 假設所有塊的大小都相同
@@ -7090,7 +7247,7 @@ pysmoveclient(Client *target, int sx, int sy)
 					clientids[1] = sepcontainers[1]->id;
 					LOG_FORMAT("movemouseswitcher 3.5 newmxy:%d,%d", newmxy.row, newmxy.col);
 					spiralplace(sepcontainers, 2, targetpos);
-					pyplace(targetindex, 2, targetpos, clientids);
+					placementplace(getcurtagindex(selmon), targetindex, targetpos, clientids, 2);
 					LOG_FORMAT("movemouseswitcher 4");
 				}else{
 					LOG_FORMAT("movemouseswitcher 7");
@@ -7100,7 +7257,7 @@ pysmoveclient(Client *target, int sx, int sy)
 					Container *cs[1];
 					cs[0] = oldc->container;
 					spiralplace(cs, 1, targetpos); // c实现的移动
-					pyplace(targetindex, 1, targetpos, clientids); // 用python移动, 但是不启动python服务就什么都不会发生, 
+					placementplace(getcurtagindex(selmon), targetindex, targetpos, clientids, 1);
 					LOG_FORMAT("movemouseswitcher 8");
 				}
 
@@ -7598,52 +7755,75 @@ propertynotify(XEvent *e)
 		updatesystray();
 	}
 
+	/* keep HIDDEN() in step when someone else rewrites WM_STATE, our own
+	 * writes are known already and are not read back */
+	if (ev->atom == wmatom[WMState] && (c = wintoclient(ev->window))) {
+		if (ev->state == PropertyDelete)
+			c->state = -1;
+		else if (c->statewrites > 0)
+			c->statewrites--;
+		else
+			c->state = getstate(c->win);
+	}
+
     if ((ev->window == root) && (ev->atom == XA_WM_NAME))
 		updatestatus();
 	else if (ev->state == PropertyDelete)
 		return; /* ignore */
 	else if ((c = wintoclient(ev->window))) {
+		/* the title falls back to WM_NAME and the icon is read once per size */
+		Atom fetch[] = { ev->atom, ev->atom == XA_WM_NAME ? netatom[NetWMName] : XA_WM_NAME };
+		/* updatewindowtype() reads the state along with the type */
+		Atom typefetch[] = { netatom[NetWMWindowType], netatom[NetWMState] };
+		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName])
+			propprefetch(c->win, fetch, 2);
+		else if (ev->atom == netatom[NetWMWindowType])
+			propprefetch(c->win, typefetch, 2);
+		else if (ev->atom == netatom[NetWMIcon])
+			propprefetch(c->win, fetch, 1);
 		switch(ev->atom) {
 		default: break;
 		case XA_WM_TRANSIENT_FOR:
-			if (!c->isfloating && (XGetTransientForHint(dpy, c->win, &trans)) 
+			if (!c->isfloating && (proptransient(c->win, &trans)) 
 			// idea 弹窗后其他窗口会变成floating, 这里先注释掉
 			// && (c->isfloating = (wintoclient(trans)) != NULL)
 			)
-			arrange(c->mon);
+			markdirty(c->mon, DirtyLayout);
 			break;
 		case XA_WM_NORMAL_HINTS:
 			c->hintsvalid = 0;
 			break;
 		case XA_WM_HINTS:
 			updatewmhints(c);
-			drawbars();
-			updateswitchersticky(selmon);
+			markdirty(NULL, DirtyBar);
+			markdirty(selmon, DirtySticky);
 			break;
 		}
 		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
 			updatetitle(c);
 			if (c == c->mon->sel)
-				drawbar(c->mon);
+				markdirty(c->mon, DirtyBar);
 		}
 		if (ev->atom == XA_WM_CLASS) {
 			updateclass(c);
 			if (c == c->mon->sel)
-				drawbar(c->mon);
+				markdirty(c->mon, DirtyBar);
 		}
 		if (ev->atom == netatom[NetMyNote]) {
 			updatenote(c);
 			if (c == c->mon->sel)
-				drawbar(c->mon);
+				markdirty(c->mon, DirtyBar);
 		}
 		else if (ev->atom == netatom[NetWMIcon]) {
-			updateicon(c);
-			updateicons(c);
+			updateiconset(c);
 			if (c == c->mon->sel)
-				drawbar(c->mon);
+				markdirty(c->mon, DirtyBar);
 		}
 		if (ev->atom == netatom[NetWMWindowType])
 			updatewindowtype(c);
+		if (ev->atom == netatom[NetWMBypassCompositor])
+			updatebypass(c);
+		propdrop();
 	}
 }
 
@@ -7698,6 +7878,7 @@ removesystrayicon(Client *i)
 	for (ii = &systray->icons; *ii && *ii != i; ii = &(*ii)->next);
 	if (ii)
 		*ii = i->next;
+	wintabledel(systraytable, LENGTH(systraytable), i);
 	free(i);
 }
 
@@ -7884,7 +8065,7 @@ restack(Monitor *m)
 	XEvent ev;
 	XWindowChanges wc;
 
-	drawbar(m);
+	markdirty(m, DirtyBar);
 	if (!m->sel)
 		return;
 	if(m->switcher)
@@ -7988,6 +8169,7 @@ run(void)
 
 	/* main event loop */
 	while (running) {
+		httpasyncbatch();
 		event_count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
 
 		for (int i = 0; i < event_count; i++) {
@@ -8005,12 +8187,21 @@ run(void)
 							tags, LENGTH(tags), layouts, LENGTH(layouts)) < 0) {
 					fprintf(stderr, "Error handling IPC event on fd %d\n", event_fd);
 				}
+			} else if (httpasyncownsfd(event_fd)) {
+				httpasynchandle(events + i);
+			} else if (thumbownsfd(event_fd)) {
+				thumbhandle(events + i);
+			} else if (statusownsfd(event_fd)) {
+				statushandle(events + i);
+			} else if (procownsfd(event_fd)) {
+				prochandle(events + i);
 			} else {
 				fprintf(stderr, "Got event from unknown fd %d, ptr %p, u32 %d, u64 %lu",
 						event_fd, events[i].data.ptr, events[i].data.u32,
 						events[i].data.u64);
 				fprintf(stderr, " with events %d\n", events[i].events);
-				return;
+				/* most likely closed by a handler earlier in this batch */
+				continue;
 			}
 		}
 	}
@@ -8057,18 +8248,35 @@ sendmon(Client *c, Monitor *m)
 	detach(c);
 	detachstack(c);
 	c->mon = m;
-	c->tags = m->tagset[m->seltags]; /* assign tags of target monitor */
+	setclienttags(c, m->tagset[m->seltags]); /* assign tags of target monitor */
 	attach(c);
 	attachstack(c);
 	focus(NULL);
 	arrange(NULL);
 }
 
+/* _NET_WM_STATE from the flags we keep */
+void
+updatenetwmstate(Client *c)
+{
+	Atom state[2];
+	int n = 0;
+
+	if (c->isfullscreen)
+		state[n++] = netatom[NetWMFullscreen];
+	if (c->tagunmapped)
+		state[n++] = netatom[NetWMStateHidden];
+	XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
+		PropModeReplace, (unsigned char *)state, n);
+}
+
 void
 setclientstate(Client *c, long state)
 {
 	long data[] = { state, None };
 
+	c->state = state;
+	c->statewrites++;
 	XChangeProperty(dpy, c->win, wmatom[WMState], wmatom[WMState], 32,
 		PropModeReplace, (unsigned char *)data, 2);
 }
@@ -8083,6 +8291,7 @@ sendevent(Window w, Atom proto, int mask, long d0, long d1, long d2, long d3, lo
 
 	if (proto == wmatom[WMTakeFocus] || proto == wmatom[WMDelete]) {
 		mt = wmatom[WMProtocols];
+		roundtrips++;
 		if (XGetWMProtocols(dpy, w, &protocols, &n)) {
 			while (!exists && n--)
 				exists = protocols[n] == proto;
@@ -8132,19 +8341,19 @@ void
 setfullscreen(Client *c, int fullscreen)
 {
 	if (fullscreen && !c->isfullscreen) {
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)&netatom[NetWMFullscreen], 1);
 		c->isfullscreen = 1;
+		updatenetwmstate(c);
 		c->oldstate = c->isfloating;
 		c->oldbw = c->bw;
 		c->bw = 0;
 		c->isfloating = 1;
+		/* let the server scan out fullscreen video and games directly */
+		previewfullscreen(c);
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
 		XRaiseWindow(dpy, c->win);
 	} else if (!fullscreen && c->isfullscreen){
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)0, 0);
 		c->isfullscreen = 0;
+		updatenetwmstate(c);
 		c->isfloating = c->oldstate;
 		c->bw = c->oldbw;
 		c->x = c->oldx;
@@ -8427,8 +8636,12 @@ initcornerwin(void)
 void
 setupepoll(void)
 {
-	epoll_fd = epoll_create1(0);
+	const char *sockpath;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 	dpy_fd = ConnectionNumber(dpy);
+	/* spawned commands cannot close it themselves, see spawn.c */
+	fcntl(dpy_fd, F_SETFD, FD_CLOEXEC);
 	struct epoll_event dpy_event;
 
 	// Initialize struct to 0
@@ -8448,14 +8661,24 @@ setupepoll(void)
 		exit(1);
 	}
 
-	if (ipc_init(ipcsockpath, epoll_fd, ipccommands, LENGTH(ipccommands)) < 0) {
+	/* a second dwm, like the benchmarks', must not take the socket of the first */
+	if (!(sockpath = getenv("DWM_SOCKET")) || !*sockpath)
+		sockpath = ipcsockpath;
+	if (ipc_init(sockpath, epoll_fd, ipccommands, LENGTH(ipccommands)) < 0) {
 		fputs("Failed to initialize IPC\n", stderr);
 	}
+
+	setupplacement();
+	setupthumb(epoll_fd);
+	setupstatus(epoll_fd);
+	setupproc(epoll_fd);
 }
 
 void
 setup(void)
 {
+	metricsstart = metricsnow();
+	setuppreview();
 	FC_HEAD = (Client*)malloc(sizeof(Client));
 	memset(FC_HEAD, 0, sizeof(FC_HEAD));
 	focuschain = FC_HEAD;
@@ -8522,6 +8745,7 @@ setup(void)
 	netatom[NetWMState] = XInternAtom(dpy, "_NET_WM_STATE", False);
 	netatom[NetWMCheck] = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
 	netatom[NetWMFullscreen] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	netatom[NetWMStateHidden] = XInternAtom(dpy, "_NET_WM_STATE_HIDDEN", False);
 	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
 	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
@@ -8537,6 +8761,7 @@ setup(void)
 
 	netatom[NetWmPid] = XInternAtom(dpy, "_NET_WM_PID", False);
 	netatom[NetMyNote] = XInternAtom(dpy, "_NET_MY_NOTE", False);
+	netatom[NetWMBypassCompositor] = XInternAtom(dpy, "_NET_WM_BYPASS_COMPOSITOR", False);
 
 
 	xatom[Manager] = XInternAtom(dpy, "MANAGER", False);
@@ -8609,7 +8834,7 @@ seturgent(Client *c, int urg)
 {
 	XWMHints *wmh;
 
-	c->isurgent = urg;
+	setclienturgent(c, urg);
 	if (!(wmh = XGetWMHints(dpy, c->win)))
 		return;
 	wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
@@ -8626,18 +8851,25 @@ hide(Client *c) {
 	Window w = c->win;
 	static XWindowAttributes ra, ca;
 
-	// more or less taken directly from blackbox's hide() function
-	XGrabServer(dpy);
-	XGetWindowAttributes(dpy, root, &ra);
-	XGetWindowAttributes(dpy, w, &ca);
-	// prevent UnmapNotify events
-	XSelectInput(dpy, root, ra.your_event_mask & ~SubstructureNotifyMask);
-	XSelectInput(dpy, w, ca.your_event_mask & ~StructureNotifyMask);
-	XUnmapWindow(dpy, w);
-	setclientstate(c, IconicState);
-	XSelectInput(dpy, root, ra.your_event_mask);
-	XSelectInput(dpy, w, ca.your_event_mask);
-	XUngrabServer(dpy);
+	if (c->tagunmapped) {
+		/* unmapped and iconic already, but tagmap() must not show it */
+		c->tagunmapped = 0;
+		updatenetwmstate(c);
+	} else {
+		// more or less taken directly from blackbox's hide() function
+		XGrabServer(dpy);
+		XGetWindowAttributes(dpy, root, &ra);
+		XGetWindowAttributes(dpy, w, &ca);
+		roundtrips += 2;
+		// prevent UnmapNotify events
+		XSelectInput(dpy, root, ra.your_event_mask & ~SubstructureNotifyMask);
+		XSelectInput(dpy, w, ca.your_event_mask & ~StructureNotifyMask);
+		XUnmapWindow(dpy, w);
+		setclientstate(c, IconicState);
+		XSelectInput(dpy, root, ra.your_event_mask);
+		XSelectInput(dpy, w, ca.your_event_mask);
+		XUngrabServer(dpy);
+	}
 
 	focus(NULL);
 	/*arrange(c->mon);*/
@@ -8674,6 +8906,44 @@ void restorewin(const Arg *arg) {
 }
 
 
+/* keeps what the windows tagunmap() is about to unmap show.  showhide()
+ * maps the newly visible windows first, over them, so this runs before */
+static void
+tagcapture(Client *c)
+{
+	if (!unmaphidden)
+		return;
+	for (; c; c = c->snext)
+		if (!ISVISIBLE(c) && !c->tagunmapped && !HIDDEN(c))
+			previewunmap(c);
+}
+
+/* unmaps a window whose tags are not shown, so that it stops drawing.  its
+ * preview was kept by tagcapture() */
+void
+tagunmap(Client *c)
+{
+	if (c->tagunmapped || HIDDEN(c))
+		return;
+	c->tagunmapped = 1;
+	/* reported once to the window and once to root */
+	c->ignoreunmap += 2;
+	XUnmapWindow(dpy, c->win);
+	setclientstate(c, IconicState);
+	updatenetwmstate(c);
+}
+
+void
+tagmap(Client *c)
+{
+	if (!c->tagunmapped)
+		return;
+	c->tagunmapped = 0;
+	setclientstate(c, NormalState);
+	updatenetwmstate(c);
+	XMapWindow(dpy, c->win);
+}
+
 void
 showhide(Client *c)
 {
@@ -8683,13 +8953,17 @@ showhide(Client *c)
 	if (ISVISIBLE(c)) {
 		/* show clients top down */
 		XMoveWindow(dpy, c->win, c->x, c->y);
+		tagmap(c);
 		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
 			resize(c, c->x, c->y, c->w, c->h, 0);
 		showhide(c->snext);
 	} else {
 		/* hide clients bottom up */
 		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+		if (unmaphidden)
+			tagunmap(c);
+		else
+			XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
 	}
 }
 
@@ -8754,35 +9028,19 @@ sigterm(int unused)
 void
 sigstatusbar(const Arg *arg)
 {
-	union sigval sv;
-
 	if (!statussig)
 		return;
-	sv.sival_int = arg->i;
-	if ((statuspid = getstatusbarpid()) <= 0)
-		return;
-
-	sigqueue(statuspid, SIGRTMIN+statussig, sv);
+	if (usestatusblocks)
+		statusclick(statussig, arg->i);
+	else
+		statusbarsignal(SIGRTMIN+statussig, arg->i);
 }
 
 pid_t
 forkrun(const Arg *arg)
 {
 	lastspawntime = getcurrusec();
-	pid_t pid = fork();
-	if (pid == 0) {
-		// child process
-		if (dpy)
-			close(ConnectionNumber(dpy));
-		setsid();
-		execvp(((char **)arg->v)[0], (char **)arg->v);
-		fprintf(stderr, "dwm: execvp %s", ((char **)arg->v)[0]);
-		perror(" failed");
-		exit(EXIT_SUCCESS);
-	}else{
-		// parent process
-		return pid;
-	}
+	return spawncmd((char **)arg->v);
 }
 
 void
@@ -8872,47 +9130,16 @@ getcwd_by_pid(pid_t pid) {
 }
 
 void getstworkingdir(char *workingdir, pid_t currpid){
-	DIR *dirp;
-	struct dirent *direntp;
-	unsigned long childpid = 0L;
-	char buf[512];
-	char appname[512];
- 
- 	dirp=opendir("/proc");
-	while((direntp=readdir(dirp))!=NULL) 
-	{
-		if (direntp->d_type == DT_DIR) {
-			char dirbuf[512]; 
-			memset(dirbuf,0,sizeof(dirbuf)); 
-			strcpy(dirbuf,"/proc"); 
-			strcat(dirbuf,"/"); 
-			strcat(dirbuf,direntp->d_name); 
-			pid_t pid;
-			int r = sscanf(direntp->d_name, "%d",&pid);
-			if (r) {
-				if(currpid == getppidof(pid)){
-					childpid = pid;
-					snprintf(buf, sizeof buf, "/proc/%d/stat", pid);
-					sscanf(buf, "%*d (%s) %*s", appname);
-					break;
-				}
-			}
-		}
-	}
-	if (childpid && strcmp(appname, "bash")) {
-		char *cwd = getcwd_by_pid(childpid);
-		if (cwd) {
-			strcpy(workingdir, cwd);
-			free(cwd);
-		}
-	}else{
-		char *cwd = getcwd_by_pid(currpid);
-		if (cwd) {
-			strcpy(workingdir, cwd);
-			free(cwd);
-		}
+	pid_t childpid;
+	char *cwd;
+
+	/* the shell, or whatever runs in the terminal */
+	if (!(childpid = procchild(currpid)) || !(cwd = getcwd_by_pid(childpid)))
+		cwd = getcwd_by_pid(currpid);
+	if (cwd) {
+		strcpy(workingdir, cwd);
+		free(cwd);
 	}
-	closedir(dirp);
 }
 
 void 
@@ -9041,7 +9268,7 @@ void reltag(const Arg *arg)
 
 	if (selmon->sel && nexttags & TAGMASK)
 	{
-		selmon->sel->tags = nexttags & TAGMASK;
+		setclienttags(selmon->sel, nexttags & TAGMASK);
 		focus(NULL);
 		arrange(selmon);
 		Arg viewarg = {.ui = nexttags};
@@ -9074,7 +9301,7 @@ void reltagd(const Arg *arg)
 
 	if (selmon->sel && nexttags & TAGMASK)
 	{
-		selmon->sel->tags = nexttags & TAGMASK;
+		setclienttags(selmon->sel, nexttags & TAGMASK);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -9089,7 +9316,7 @@ tag(const Arg *arg)
 			// 拆
 			separatefromcontainer(oldc);
 		}
-		selmon->sel->tags = arg->ui & TAGMASK;
+		setclienttags(selmon->sel, arg->ui & TAGMASK);
 		focus(NULL);
 		arrange(selmon);
 		if(viewontag && ((arg->ui & TAGMASK) != TAGMASK))
@@ -10101,89 +10328,29 @@ tile5maximize(const Arg *arg)
 }
 
 int
-pyresort3(Container *cs[], int n, int resorted[])
+smartresort(Container *cs[], int n, int resorted[])
 {
 	if(n==0) return 0;
-	int i;
-	char *url = "http://localhost:8666/resort";
-	char params[3000];
-	memset(params, 0, sizeof(params));
+	int i, j;
+	int launchparents[n];
+	int ids[n];
+	int selindex = -1;
 
-	strcat(params, "tag=");
-	char tag[2];
-	sprintf(tag, "%d", getcurtagindex(selmon));
-	strcat(params, tag);
-	strcat(params, "&");
-	strcat(params, "launchparents=");
 	for(i=0;i<n;i++)
 	{
-		Container *lp = cs[i]->launchparent;
-		char str[5];
-		int foundindex = -1;
-		int j;
+		launchparents[i] = -1;
 		for(j=0;j<n;j++)
 		{
-			if (lp == cs[j]) {
-				foundindex = j;
+			if (cs[i]->launchparent == cs[j]) {
+				launchparents[i] = j;
 				break;
 			}
 		}
-		sprintf(str, "%d", foundindex);
-		strcat(params, str);
-		if(i!=n-1)
-			strcat(params, ",");
-	}
-
-	strcat(params, "&");
-	strcat(params, "ids=");
-	for(i=0;i<n;i++)
-	{
-		Container *c = cs[i];
-		char str[5];
-		sprintf(str, "%d", c->id);
-		strcat(params, str);
-		if(i!=n-1)
-			strcat(params, ",");
-	}
-
-	if(selmon->sel){
-		strcat(params, "&");
-		strcat(params, "selindex=");
-		for (i = 0; i < n; i++)
-		{
-			Container *c = cs[i];
-			if (selmon->sel->container == c)
-			{
-				char str[5];
-				sprintf(str, "%d", i);
-				strcat(params, str);
-			}
-		}
-	}
-
-	LOG_FORMAT("pysort3 %s", params);
-	struct HttpResponse resp;
-	resp.content = malloc(1);
-	resp.size = 0;
-	resp.code = CURLE_OK;
-	int ok = httppost(url,params, &resp);
-	if (!ok) 
-	{
-		free(resp.content);
-		return 0;
-	}
-
-	int j = 0;
-	char *temp = strtok(resp.content,",");
-	while(temp)
-	{
-		LOG_FORMAT("pyresort3 %s", temp);
-		sscanf(temp,"%d",&resorted[j]);
-		j++;
-		temp = strtok(NULL,",");
+		ids[i] = cs[i]->id;
+		if (selmon->sel && selmon->sel->container == cs[i])
+			selindex = i;
 	}
-	free(resp.content);
-	return 1;
+	return placementresort(getcurtagindex(selmon), launchparents, ids, n, selindex, resorted);
 }
 
 Container *
@@ -10191,6 +10358,7 @@ createcontainer()
 {
 	Container *container = (Container *)malloc(sizeof(Container));
 	memset(container, 0, sizeof(Container));
+	placementinvalidate();
 	return container;
 }
 
@@ -10218,6 +10386,7 @@ createcontainerc(Client *c)
 	c->indexincontainer = 0;
 	container->hiddencn = 0;
 	container->spirali = -1;
+	placementinvalidate();
 	return container;
 }
 
@@ -10262,6 +10431,7 @@ freecontainerc(Container *container, Client *c)
 	removeclientfromcontainer(container, c);
 	if (container->cn == 0)
 		free(container);
+	placementinvalidate();
 }
 
 void
@@ -10329,7 +10499,7 @@ tile7(Monitor *m)
 	int initn = 121;
 	int resorted[initn];
 	memset(resorted, -1, sizeof(resorted));
-	int resortok = pyresort3(tiledcs, ctn, resorted);
+	int resortok = smartresort(tiledcs, ctn, resorted);
 	
 	/*LOG_FORMAT("%d %d", resorted[0], resorted[1]);*/
 	if(resortok)
@@ -10481,7 +10651,9 @@ tile7(Monitor *m)
 	for(i=0;i<ctn;i++)
 	{
 		if (tiledcs[i]->cn > 0) {
+			unsigned long long start = metricsnow();
 			tiledcs[i]->arrange(tiledcs[i]);
+			metricscontainer(tiledcs[i]->arrange, start);
 		}
 	}
 
@@ -12455,12 +12627,12 @@ hidescratchitem(ScratchItem *si, int returntags)
 	if(!c) return;
 	c->isfloating = 0;
 	if (returntags)
-		c-> tags = returntags;
+		setclienttags(c, returntags);
 	else
 		if (si->pretags)
-			c->tags = si->pretags;
+			setclienttags(c, si->pretags);
 		else
-			c->tags = selmon->tagset[selmon->seltags];
+			setclienttags(c, selmon->tagset[selmon->seltags]);
 
 	si->x = c->x;
 	si->y = c->y;
@@ -13380,7 +13552,7 @@ toggletag(const Arg *arg)
 		return;
 	newtags = selmon->sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
-		selmon->sel->tags = newtags;
+		setclienttags(selmon->sel, newtags);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -13470,14 +13642,21 @@ unmanage(Client *c, int destroyed)
 
 	removefromscratchgroupc(c);
 	removefromfocuschain(c);
+	wintabledel(clienttable, LENGTH(clienttable), c);
 	detach(c);
 	detachstack(c);
 	freeicon(c);
 	freeicons(c);
+	previewfree(c);
+	tilefree(&c->tile);
+	tilefree(&c->stickytile);
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
 		XSetErrorHandler(xerrordummy);
+		/* only we unmapped it, hand it back the way it was given to us */
+		if (c->tagunmapped)
+			XMapWindow(dpy, c->win);
 		XConfigureWindow(dpy, c->win, CWBorderWidth, &wc); /* restore border */
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
 		setclientstate(c, WithdrawnState);
@@ -13491,8 +13670,8 @@ unmanage(Client *c, int destroyed)
 	if (selmon->sel) 
 		// centertocamera(selmon->sel->x+selmon->sel->w/2,selmon->sel->y+selmon->sel->h/2);
 		tile5viewcomplete(0);
-	updateclientlist();
-	arrange(m);
+	markdirty(NULL, DirtyClientList);
+	markdirty(m, DirtyLayout);
 
 	if (countcurtag(m->clients) == 0)
 	{
@@ -13504,10 +13683,8 @@ unmanage(Client *c, int destroyed)
 	}
 
 
-	if(m->switcher)
-		m->switcheraction.drawfunc(m->switcher, m->switcherww, m->switcherwh);
-	if(m->switcherstickywin)
-		m->switcherstickyaction.drawfunc(m->switcherstickywin, m->switcherstickyww, m->switcherstickywh);
+	markdirty(m, DirtySwitcher);
+	markdirty(m, DirtySticky);
 }
 
 void
@@ -13517,7 +13694,14 @@ unmapnotify(XEvent *e)
 	XUnmapEvent *ev = &e->xunmap;
 
 	if ((c = wintoclient(ev->window))) {
-		if (ev->send_event)
+		if (!ev->send_event && c->ignoreunmap > 0)
+			c->ignoreunmap--; /* our own, from tagunmap() */
+		else if (ev->send_event && c->tagunmapped) {
+			/* withdrawn while we had it unmapped, the synthetic event is
+			 * all it sends, and it has to stay unmapped */
+			c->tagunmapped = 0;
+			unmanage(c, 0);
+		} else if (ev->send_event)
 			setclientstate(c, WithdrawnState);
 		else
 			unmanage(c, 0);
@@ -13634,7 +13818,7 @@ updategeom(void)
 				for (m = mons; m && m->next; m = m->next);
 				while ((c = m->clients)) {
 					dirty = 1;
-					m->clients = c->next;
+					detach(c);
 					detachstack(c);
 					c->mon = mons;
 					attach(c);
@@ -13687,7 +13871,7 @@ updatesizehints(Client *c)
 	long msize;
 	XSizeHints size;
 
-	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
+	if (!propsizehints(c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
 	if (size.flags & PBaseSize) {
@@ -13728,26 +13912,24 @@ updatesizehints(Client *c)
 void
 updatestatus(void)
 {
-	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext))) {
-		strcpy(stext, "dwm-"VERSION);
-		statusw = TEXTW(stext) - lrpad + 2;
-	} else {
-		char *text, *s, ch;
-
-		statusw  = 0;
-		for (text = s = stext; *s; s++) {
-			if ((unsigned char)(*s) < ' ') {
-				ch = *s;
-				*s = '\0';
-				statusw += TEXTW(text) - lrpad;
-				*s = ch;
-				text = s + 1;
-			}
-		}
-		statusw += TEXTW(text) - lrpad + 2;
+	char *text, *s, ch;
 
-	}
-	drawbar(selmon);
+	if (usestatusblocks)
+		statusjoin(stext, sizeof(stext));
+	else if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
+		strcpy(stext, "dwm-"VERSION);
+	statusw = 0;
+	for (text = s = stext; *s; s++) {
+		if ((unsigned char)(*s) < ' ') {
+			ch = *s;
+			*s = '\0';
+			statusw += TEXTW(text) - lrpad;
+			*s = ch;
+			text = s + 1;
+		}
+	}
+	statusw += TEXTW(text) - lrpad + 2;
+	markdirty(selmon, DirtyBar);
 	updatesystray();
 }
 
@@ -13941,12 +14123,12 @@ updatewmhints(Client *c)
 {
 	XWMHints *wmh;
 
-	if ((wmh = XGetWMHints(dpy, c->win))) {
+	if ((wmh = propwmhints(c->win))) {
 		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
 			wmh->flags &= ~XUrgencyHint;
 			XSetWMHints(dpy, c->win, wmh);
 		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+			setclienturgent(c, (wmh->flags & XUrgencyHint) ? 1 : 0);
 		if (wmh->flags & InputHint)
 			c->neverfocus = !wmh->input;
 		else
@@ -13969,80 +14151,11 @@ getcurrusec(){
 // 	return us.tv_sec;
 // }
 
-static uint32_t prealpha(uint32_t p) {
-	uint8_t a = p >> 24u;
-	uint32_t rb = (a * (p & 0xFF00FFu)) >> 8u;
-	uint32_t g = (a * (p & 0x00FF00u)) >> 8u;
-	return (rb & 0xFF00FFu) | (g & 0x00FF00u) | (a << 24u);
-}
-
-Picture
-geticonpropv(Window win, unsigned int *picw, unsigned int *pich, int icon_size)
-{
-	int format;
-	unsigned long n, extra, *p = NULL;
-	Atom real;
-
-	if (XGetWindowProperty(dpy, win, netatom[NetWMIcon], 0L, LONG_MAX, False, AnyPropertyType, 
-						   &real, &format, &n, &extra, (unsigned char **)&p) != Success)
-		return None; 
-	if (n == 0 || format != 32) { XFree(p); return None; }
-
-	unsigned long *bstp = NULL;
-	uint32_t w, h, sz;
-	{
-		unsigned long *i; const unsigned long *end = p + n;
-		uint32_t bstd = UINT32_MAX, d, m;
-		for (i = p; i < end - 1; i += sz) {
-			if ((w = *i++) >= 16384 || (h = *i++) >= 16384) { XFree(p); return None; }
-			if ((sz = w * h) > end - i) break;
-			if ((m = w > h ? w : h) >= icon_size && (d = m - icon_size) < bstd) { bstd = d; bstp = i; }
-		}
-		if (!bstp) {
-			for (i = p; i < end - 1; i += sz) {
-				if ((w = *i++) >= 16384 || (h = *i++) >= 16384) { XFree(p); return None; }
-				if ((sz = w * h) > end - i) break;
-				if ((d = icon_size - (w > h ? w : h)) < bstd) { bstd = d; bstp = i; }
-			}
-		}
-		if (!bstp) { XFree(p); return None; }
-	}
-
-	if ((w = *(bstp - 2)) == 0 || (h = *(bstp - 1)) == 0) { XFree(p); return None; }
-
-	uint32_t icw, ich;
-	if (w <= h) {
-		ich = icon_size; icw = w * icon_size / h;
-		if (icw == 0) icw = 1;
-	}
-	else {
-		icw = icon_size; ich = h * icon_size / w;
-		if (ich == 0) ich = 1;
-	}
-	*picw = icw; *pich = ich;
-
-	uint32_t i, *bstp32 = (uint32_t *)bstp;
-	for (sz = w * h, i = 0; i < sz; ++i) bstp32[i] = prealpha(bstp[i]);
-
-	Picture ret = drw_picture_create_resized(drw, (char *)bstp, w, h, icw, ich);
-	XFree(p);
-
-	return ret;
-}
-
-Picture
-geticonprop(Window win, unsigned int *picw, unsigned int *pich)
-{
-	return geticonpropv(win, picw, pich, ICONSIZE);
-}
-
 void
 freeicon(Client *c)
 {
-	if (c->icon) {
-		XRenderFreePicture(dpy, c->icon);
-		c->icon = None;
-	}
+	iconrelease(c->icon);
+	c->icon = NULL;
 }
 
 void
@@ -14051,29 +14164,8 @@ freeicons(Client *c)
 	int i;
 	for(i = 0;i<3;i++)
 	{
-		if (c->icons[i]) {
-			XRenderFreePicture(dpy, c->icons[i]);
-			c->icons[i] = None;
-		}
-	}
-}
-
-void
-updateicon(Client *c)
-{
-	freeicon(c);
-	c->icon = geticonprop(c->win, &c->icw, &c->ich);
-}
-
-void
-updateicons(Client *c)
-{
-	freeicons(c);
-	int i;
-	for(i = 0;i<3;i++)
-	{
-		int j = pow(2,i);
-		c->icons[i] = geticonpropv(c->win, &(c->icws[i]), &(c->ichs[i]), j * 32);
+		iconrelease(c->icons[i]);
+		c->icons[i] = NULL;
 	}
 }
 
@@ -14408,27 +14500,53 @@ relview(const Arg *arg)
 	
 }
 
+static unsigned int
+wintablehash(Window w, unsigned int size)
+{
+	/* window ids are allocated in sequence within a client's resource range */
+	return (unsigned int)((w ^ (w >> 16)) * 2654435761UL) & (size - 1);
+}
+
+void
+wintableadd(Client **table, unsigned int size, Client *c)
+{
+	Client **b = &table[wintablehash(c->win, size)];
+
+	c->wnext = *b;
+	*b = c;
+}
+
+void
+wintabledel(Client **table, unsigned int size, Client *c)
+{
+	Client **tc;
+
+	for (tc = &table[wintablehash(c->win, size)]; *tc && *tc != c; tc = &(*tc)->wnext);
+	if (*tc)
+		*tc = c->wnext;
+	c->wnext = NULL;
+}
+
 Client *
-wintoclient(Window w)
+wintablefind(Client **table, unsigned int size, Window w)
 {
 	Client *c;
-	Monitor *m;
 
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
-	return NULL;
+	for (c = table[wintablehash(w, size)]; c && c->win != w; c = c->wnext);
+	return c;
 }
 
 Client *
-wintosystrayicon(Window w) {
-	Client *i = NULL;
+wintoclient(Window w)
+{
+	return wintablefind(clienttable, LENGTH(clienttable), w);
+}
 
+Client *
+wintosystrayicon(Window w) {
 	if (!showsystray || !w)
-		return i;
-	for (i = systray->icons; i && i->win != w; i = i->next) ;
-	return i;
+		return NULL;
+	return wintablefind(systraytable, LENGTH(systraytable), w);
 }
 
 Monitor *
@@ -15006,7 +15124,7 @@ assemble(const Arg *arg)
 		{
 			item = &(taskgroupv.items[i]);
 			if (item->c) {
-				item->c->tags = item->tag;
+				setclienttags(item->c, item->tag);
 				if (item->tag) {
 					Arg argview = {.i = item->tag};
 					view(&argview);
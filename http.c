@@ -90,3 +90,253 @@ httpget(char *url, struct HttpResponse *resp)
 	}
 	return 1;
 }
+
+/* asynchronous requests, driven by a curl multi handle whose sockets and
+ * timer live in the caller's epoll set.  nothing here ever blocks, the
+ * callback runs from httpasynchandle() once the transfer is done, failed or
+ * ran past its timeout. */
+#include <sys/timerfd.h>
+
+#define HTTP_MAXFDS 16
+
+typedef void (*HttpCallback)(int ok, struct HttpResponse *resp, void *arg);
+
+struct HttpRequest {
+	CURL *curl;
+	char *params;
+	struct HttpResponse resp;
+	HttpCallback cb;
+	void *arg;
+	struct HttpRequest *next;
+};
+
+static CURLM *httpmulti;
+static int httpepollfd = -1;
+static int httptimerfd = -1;
+static int httpfds[HTTP_MAXFDS];
+static int httpfdn = 0;
+/* sockets removed while the current epoll batch still has events for them */
+static int httpgone[HTTP_MAXFDS];
+static int httpgonen = 0;
+static struct HttpRequest *httprequests;
+
+static void
+httprequestfree(struct HttpRequest *req)
+{
+	struct HttpRequest **tp;
+
+	for (tp = &httprequests; *tp && *tp != req; tp = &(*tp)->next);
+	if (*tp)
+		*tp = req->next;
+	if (req->curl) {
+		curl_multi_remove_handle(httpmulti, req->curl);
+		curl_easy_cleanup(req->curl);
+	}
+	free(req->params);
+	free(req->resp.content);
+	free(req);
+}
+
+static int
+httpsocketcb(CURL *curl, curl_socket_t s, int what, void *userp, void *socketp)
+{
+	struct epoll_event ev;
+	int i;
+
+	for (i = 0; i < httpfdn && httpfds[i] != s; i++);
+	if (what == CURL_POLL_REMOVE) {
+		if (i < httpfdn) {
+			epoll_ctl(httpepollfd, EPOLL_CTL_DEL, s, NULL);
+			httpfds[i] = httpfds[--httpfdn];
+			if (httpgonen < HTTP_MAXFDS)
+				httpgone[httpgonen++] = s;
+		}
+		return 0;
+	}
+	/* a new socket may reuse the number of one removed in this batch */
+	for (i = 0; i < httpgonen; i++)
+		if (httpgone[i] == s)
+			httpgone[i--] = httpgone[--httpgonen];
+	for (i = 0; i < httpfdn && httpfds[i] != s; i++);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = s;
+	if (what & CURL_POLL_IN)
+		ev.events |= EPOLLIN;
+	if (what & CURL_POLL_OUT)
+		ev.events |= EPOLLOUT;
+	if (i < httpfdn)
+		return epoll_ctl(httpepollfd, EPOLL_CTL_MOD, s, &ev);
+	if (httpfdn == HTTP_MAXFDS)
+		return -1;
+	httpfds[httpfdn++] = s;
+	return epoll_ctl(httpepollfd, EPOLL_CTL_ADD, s, &ev);
+}
+
+static int
+httptimercb(CURLM *multi, long timeout_ms, void *userp)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (timeout_ms > 0) {
+		its.it_value.tv_sec = timeout_ms / 1000;
+		its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+	} else if (timeout_ms == 0) {
+		/* a zero it_value would disarm the timer, fire as soon as possible */
+		its.it_value.tv_nsec = 1;
+	}
+	return timerfd_settime(httptimerfd, 0, &its, NULL);
+}
+
+int
+httpasyncinit(int epollfd)
+{
+	struct epoll_event ev;
+
+	httpmulti = curl_multi_init();
+	if (!httpmulti)
+		return -1;
+	httptimerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (httptimerfd < 0) {
+		curl_multi_cleanup(httpmulti);
+		httpmulti = NULL;
+		return -1;
+	}
+	httpepollfd = epollfd;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = httptimerfd;
+	epoll_ctl(httpepollfd, EPOLL_CTL_ADD, httptimerfd, &ev);
+
+	curl_multi_setopt(httpmulti, CURLMOPT_SOCKETFUNCTION, httpsocketcb);
+	curl_multi_setopt(httpmulti, CURLMOPT_TIMERFUNCTION, httptimercb);
+	return 0;
+}
+
+int
+httpasyncownsfd(int fd)
+{
+	int i;
+
+	if (fd < 0)
+		return 0;
+	if (fd == httptimerfd)
+		return 1;
+	for (i = 0; i < httpfdn; i++)
+		if (httpfds[i] == fd)
+			return 1;
+	/* claimed, so a stale event is dropped here instead of looking unknown */
+	for (i = 0; i < httpgonen; i++)
+		if (httpgone[i] == fd)
+			return 1;
+	return 0;
+}
+
+/* called before every epoll_wait(), events for removed sockets end with
+ * the batch they were returned in */
+void
+httpasyncbatch(void)
+{
+	httpgonen = 0;
+}
+
+static void
+httpasyncdone(void)
+{
+	struct HttpRequest *req;
+	CURLMsg *msg;
+	int pending;
+
+	while ((msg = curl_multi_info_read(httpmulti, &pending))) {
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+		req->resp.code = msg->data.result;
+		if (req->cb)
+			req->cb(req->resp.code == CURLE_OK, &req->resp, req->arg);
+		httprequestfree(req);
+	}
+}
+
+void
+httpasynchandle(struct epoll_event *ev)
+{
+	uint64_t expirations;
+	int flags = 0, running, i;
+
+	if (!httpmulti)
+		return;
+	for (i = 0; i < httpgonen; i++)
+		if (httpgone[i] == ev->data.fd)
+			return;
+	if (ev->data.fd == httptimerfd) {
+		if (read(httptimerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+			return;
+		curl_multi_socket_action(httpmulti, CURL_SOCKET_TIMEOUT, 0, &running);
+	} else {
+		if (ev->events & EPOLLIN)
+			flags |= CURL_CSELECT_IN;
+		if (ev->events & EPOLLOUT)
+			flags |= CURL_CSELECT_OUT;
+		if (ev->events & (EPOLLERR | EPOLLHUP))
+			flags |= CURL_CSELECT_ERR;
+		curl_multi_socket_action(httpmulti, ev->data.fd, flags, &running);
+	}
+	httpasyncdone();
+}
+
+/* starts a POST and returns at once, cb is called exactly once unless the
+ * request could not be started (return 0) */
+int
+httppostasync(const char *url, const char *params, long timeoutms, HttpCallback cb, void *arg)
+{
+	struct HttpRequest *req;
+
+	if (!httpmulti)
+		return 0;
+	req = calloc(1, sizeof(struct HttpRequest));
+	if (!req)
+		return 0;
+	req->curl = curl_easy_init();
+	req->params = strdup(params);
+	req->resp.content = malloc(1);
+	if (!req->curl || !req->params || !req->resp.content) {
+		httprequestfree(req);
+		return 0;
+	}
+	req->resp.content[0] = '\0';
+	req->cb = cb;
+	req->arg = arg;
+
+	curl_easy_setopt(req->curl, CURLOPT_URL, url);
+	curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, req->params);
+	curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+	curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, (void *)&req->resp);
+	curl_easy_setopt(req->curl, CURLOPT_PRIVATE, req);
+	curl_easy_setopt(req->curl, CURLOPT_TIMEOUT_MS, timeoutms);
+	curl_easy_setopt(req->curl, CURLOPT_NOSIGNAL, 1L);
+	if (curl_multi_add_handle(httpmulti, req->curl) != CURLM_OK) {
+		httprequestfree(req);
+		return 0;
+	}
+	req->next = httprequests;
+	httprequests = req;
+	return 1;
+}
+
+void
+httpasynccleanup(void)
+{
+	if (!httpmulti)
+		return;
+	/* drop whatever is still in flight without calling back */
+	while (httprequests)
+		httprequestfree(httprequests);
+	curl_multi_cleanup(httpmulti);
+	httpmulti = NULL;
+	if (httptimerfd >= 0)
+		close(httptimerfd);
+	httptimerfd = -1;
+	httpfdn = 0;
+}
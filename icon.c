@@ -0,0 +1,371 @@
+/* window icons from _NET_WM_ICON.
+ *
+ * the bar icon and the three switcher sizes used to be made by four calls
+ * that each fetched the whole property, searched it and premultiplied the
+ * chosen image again.  updateiconset() fetches and parses the property once,
+ * premultiplies each chosen image once (four pixels at a time with SSE2),
+ * and uploads it once for every size it is scaled to by at most half.
+ * images needing more reduction are box-filtered here (thumbscale()) rather
+ * than going through Imlib.
+ *
+ * the result is shared: icons are looked up by a hash of the source image
+ * and their size and reference counted, so identical windows hold the same
+ * Icon.  icons of at most ICON_ATLASMAX pixels made by reduction live in one
+ * ARGB atlas and are drawn from it with a source offset (drawicon()).  the
+ * atlas is cut into ICON_ATLASBLOCK square blocks, each split into cells of
+ * one size, so a freed cell can be reused.
+ *
+ * included from dwm.c after thumb.c.
+ */
+
+#define ICON_MAXENTRIES 32
+#define ICON_SIZES      4   /* the bar icon, then icons[0..2] */
+#define ICON_BUCKETS    64  /* power of two */
+#define ICON_ATLAS      512 /* atlas side */
+#define ICON_ATLASBLOCK 64
+#define ICON_ATLASMAX   ICON_ATLASBLOCK
+#define ICON_BLOCKS     ((ICON_ATLAS / ICON_ATLASBLOCK) * (ICON_ATLAS / ICON_ATLASBLOCK))
+
+struct Icon {
+	uint64_t hash;            /* of the source image */
+	unsigned int srcw, srch;
+	unsigned int w, h;
+	Picture pic;              /* the atlas if inatlas */
+	int x, y;                 /* of the icon in pic */
+	int inatlas;
+	int refs;
+	Icon *next;
+};
+
+typedef struct {
+	unsigned int w, h;
+	unsigned long *src; /* into the property, as Xlib hands it out */
+	uint32_t *argb;     /* premultiplied, in place over src */
+	Pixmap pm;          /* uploaded unscaled, shared by the sizes using it */
+	uint64_t hash;
+	int hashed;
+} IconEntry;
+
+typedef struct {
+	unsigned int cell; /* side of its cells, 0 while unused */
+	unsigned int used; /* bit per cell, row by row */
+} IconBlock;
+
+static Icon *iconcache[ICON_BUCKETS];
+static IconBlock iconblocks[ICON_BLOCKS];
+static Pixmap iconatlaspm;
+static Picture iconatlas;
+static unsigned long iconfetches, iconuploads, iconhits, iconcount, iconatlased;
+
+static uint32_t
+prealpha(uint32_t p)
+{
+	uint8_t a = p >> 24u;
+	uint32_t rb = (a * (p & 0xFF00FFu)) >> 8u;
+	uint32_t g = (a * (p & 0x00FF00u)) >> 8u;
+	return (rb & 0xFF00FFu) | (g & 0x00FF00u) | (a << 24u);
+}
+
+/* c * a >> 8 for every colour channel, the same as prealpha() */
+static void
+iconpremultiply(uint32_t *p, size_t n)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+	__m128i v, lo, hi, alo, ahi;
+
+	for (; i + 4 <= n; i += 4) {
+		v = _mm_loadu_si128((const __m128i *)(p + i));
+		lo = _mm_unpacklo_epi8(v, zero);
+		hi = _mm_unpackhi_epi8(v, zero);
+		/* each pixel's alpha in all four of its lanes */
+		alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		lo = _mm_srli_epi16(_mm_mullo_epi16(lo, alo), 8);
+		hi = _mm_srli_epi16(_mm_mullo_epi16(hi, ahi), 8);
+		v = _mm_or_si128(_mm_andnot_si128(amask, _mm_packus_epi16(lo, hi)),
+			_mm_and_si128(v, amask));
+		_mm_storeu_si128((__m128i *)(p + i), v);
+	}
+#endif
+	for (; i < n; i++)
+		p[i] = prealpha(p[i]);
+}
+
+/* the smallest image at least size big, else the biggest one */
+static int
+iconpick(const IconEntry *e, int n, unsigned int size)
+{
+	unsigned int m, d, bestd = UINT_MAX;
+	int i, best = -1;
+
+	for (i = 0; i < n; i++) {
+		m = MAX(e[i].w, e[i].h);
+		if (m >= size && (d = m - size) < bestd) {
+			bestd = d;
+			best = i;
+		}
+	}
+	if (best >= 0)
+		return best;
+	for (i = 0; i < n; i++) {
+		m = MAX(e[i].w, e[i].h);
+		if ((d = size - m) < bestd) {
+			bestd = d;
+			best = i;
+		}
+	}
+	return best;
+}
+
+/* FNV-1a over the size and the pixels as 32 bit words */
+static uint64_t
+iconhash(IconEntry *e)
+{
+	size_t i, sz = (size_t)e->w * e->h;
+	uint64_t h = 14695981039346656037ULL;
+
+	if (e->hashed)
+		return e->hash;
+	h = (h ^ e->w) * 1099511628211ULL;
+	h = (h ^ e->h) * 1099511628211ULL;
+	for (i = 0; i < sz; i++)
+		h = (h ^ (uint32_t)e->src[i]) * 1099511628211ULL;
+	e->hash = h;
+	e->hashed = 1;
+	return h;
+}
+
+static uint32_t *
+iconpixels(IconEntry *e)
+{
+	size_t i, sz = (size_t)e->w * e->h;
+
+	if (!e->argb) {
+		iconhash(e); /* before the pixels change under it */
+		/* longs to 32 bit in place, front to back */
+		e->argb = (uint32_t *)e->src;
+		for (i = 0; i < sz; i++)
+			e->argb[i] = e->src[i];
+		iconpremultiply(e->argb, sz);
+	}
+	return e->argb;
+}
+
+/* a free cell of at least w x h in the atlas, 0 if there is none */
+static int
+iconatlasalloc(unsigned int w, unsigned int h, int *x, int *y)
+{
+	unsigned int cell, per, full, b, i;
+
+	for (cell = 16; cell < MAX(w, h); cell <<= 1);
+	if (cell > ICON_ATLASBLOCK)
+		return 0;
+	per = ICON_ATLASBLOCK / cell;
+	full = (1U << per * per) - 1;
+	/* a block already cut into this size first, then an unused one */
+	for (b = 0; b < ICON_BLOCKS; b++)
+		if (iconblocks[b].cell == cell && iconblocks[b].used != full)
+			break;
+	if (b == ICON_BLOCKS)
+		for (b = 0; b < ICON_BLOCKS && iconblocks[b].cell; b++);
+	if (b == ICON_BLOCKS)
+		return 0;
+	iconblocks[b].cell = cell;
+	for (i = 0; iconblocks[b].used & 1U << i; i++);
+	iconblocks[b].used |= 1U << i;
+	*x = b % (ICON_ATLAS / ICON_ATLASBLOCK) * ICON_ATLASBLOCK + i % per * cell;
+	*y = b / (ICON_ATLAS / ICON_ATLASBLOCK) * ICON_ATLASBLOCK + i / per * cell;
+	return 1;
+}
+
+static void
+iconatlasfree(int x, int y)
+{
+	unsigned int b, per, cell;
+
+	b = y / ICON_ATLASBLOCK * (ICON_ATLAS / ICON_ATLASBLOCK) + x / ICON_ATLASBLOCK;
+	if (!(cell = iconblocks[b].cell))
+		return;
+	per = ICON_ATLASBLOCK / cell;
+	iconblocks[b].used &= ~(1U << ((y % ICON_ATLASBLOCK / cell) * per + x % ICON_ATLASBLOCK / cell));
+	if (!iconblocks[b].used)
+		iconblocks[b].cell = 0;
+}
+
+/* puts icw x ich pixels into the atlas, 0 if they do not fit */
+static int
+iconatlasput(Icon *ic, uint32_t *argb)
+{
+	int x, y;
+
+	if (ic->w > ICON_ATLASMAX || ic->h > ICON_ATLASMAX || !iconatlasalloc(ic->w, ic->h, &x, &y))
+		return 0;
+	if (!iconatlaspm) {
+		iconatlaspm = XCreatePixmap(dpy, root, ICON_ATLAS, ICON_ATLAS, 32);
+		iconatlas = drw_picture_create_scaled(drw, iconatlaspm,
+			ICON_ATLAS, ICON_ATLAS, ICON_ATLAS, ICON_ATLAS);
+	}
+	drw_pixmap_put_argb(drw, iconatlaspm, (char *)argb, x, y, ic->w, ic->h);
+	ic->pic = iconatlas;
+	ic->x = x;
+	ic->y = y;
+	ic->inatlas = 1;
+	iconatlased++;
+	return 1;
+}
+
+static Icon *
+iconmake(IconEntry *e, unsigned int icw, unsigned int ich)
+{
+	Icon *ic;
+	uint32_t *argb, *small = NULL;
+	Pixmap pm;
+
+	ic = ecalloc(1, sizeof(Icon));
+	ic->w = icw;
+	ic->h = ich;
+	argb = iconpixels(e);
+	iconuploads++;
+	if (e->w <= icw * 2 && e->h <= ich * 2
+	&& (e->w < icw || e->h < ich || icw > ICON_ATLASMAX || ich > ICON_ATLASMAX)) {
+		/* scaled by the server, one upload serves every size */
+		if (!e->pm)
+			e->pm = drw_pixmap_create_argb(drw, (char *)argb, e->w, e->h);
+		else
+			iconuploads--;
+		ic->pic = drw_picture_create_scaled(drw, e->pm, e->w, e->h, icw, ich);
+		return ic;
+	}
+	if (e->w != icw || e->h != ich) {
+		/* bilinear sampling would skip pixels, average them first */
+		small = ecalloc((size_t)icw * ich, sizeof(uint32_t));
+		thumbscale(argb, e->w, e->h, e->w, small, icw, ich, 0);
+		argb = small;
+	}
+	if (!iconatlasput(ic, argb)) {
+		pm = drw_pixmap_create_argb(drw, (char *)argb, icw, ich);
+		ic->pic = drw_picture_create_scaled(drw, pm, icw, ich, icw, ich);
+		XFreePixmap(dpy, pm);
+	}
+	free(small);
+	return ic;
+}
+
+/* the cached icon made from e at icw x ich, made if needed */
+static Icon *
+iconget(IconEntry *e, unsigned int icw, unsigned int ich)
+{
+	Icon *ic, **bucket;
+	uint64_t h = iconhash(e);
+
+	bucket = &iconcache[(h ^ icw ^ ich << 8) & (ICON_BUCKETS - 1)];
+	for (ic = *bucket; ic; ic = ic->next)
+		if (ic->hash == h && ic->srcw == e->w && ic->srch == e->h
+		&& ic->w == icw && ic->h == ich) {
+			ic->refs++;
+			iconhits++;
+			return ic;
+		}
+	ic = iconmake(e, icw, ich);
+	ic->hash = h;
+	ic->srcw = e->w;
+	ic->srch = e->h;
+	ic->refs = 1;
+	ic->next = *bucket;
+	*bucket = ic;
+	iconcount++;
+	return ic;
+}
+
+void
+iconrelease(Icon *ic)
+{
+	Icon **tp;
+
+	if (!ic || --ic->refs > 0)
+		return;
+	for (tp = &iconcache[(ic->hash ^ ic->w ^ ic->h << 8) & (ICON_BUCKETS - 1)];
+			*tp && *tp != ic; tp = &(*tp)->next);
+	if (*tp)
+		*tp = ic->next;
+	if (ic->inatlas)
+		iconatlasfree(ic->x, ic->y);
+	else
+		XRenderFreePicture(dpy, ic->pic);
+	iconcount--;
+	free(ic);
+}
+
+void
+drawicon(Icon *ic, int x, int y)
+{
+	drw_pic_part(drw, x, y, ic->w, ic->h, ic->pic, ic->x, ic->y);
+}
+
+/* rebuilds c->icon and c->icons[] from a single read of _NET_WM_ICON */
+void
+updateiconset(Client *c)
+{
+	const unsigned int sizes[ICON_SIZES] = { ICONSIZE, 32, 64, 128 };
+	Icon **icons[ICON_SIZES] = { &c->icon, &c->icons[0], &c->icons[1], &c->icons[2] };
+	unsigned int *ws[ICON_SIZES] = { &c->icw, &c->icws[0], &c->icws[1], &c->icws[2] };
+	unsigned int *hs[ICON_SIZES] = { &c->ich, &c->ichs[0], &c->ichs[1], &c->ichs[2] };
+	IconEntry e[ICON_MAXENTRIES];
+	Icon *old[ICON_SIZES];
+	unsigned long n, extra, i, *p = NULL;
+	unsigned int w, h, icw, ich;
+	int format, j, k, ne = 0;
+	Atom real;
+
+	/* released last, so an unchanged icon is found again instead of rebuilt */
+	for (k = 0; k < ICON_SIZES; k++) {
+		old[k] = *icons[k];
+		*icons[k] = NULL;
+	}
+	iconfetches++;
+	if (getprop(c->win, netatom[NetWMIcon], LONG_MAX, AnyPropertyType,
+			&real, &format, &n, &extra, (unsigned char **)&p) != Success)
+		p = NULL;
+	if (p && (n == 0 || format != 32))
+		n = 0;
+
+	/* width, height, then width * height pixels, repeated */
+	for (i = 0; p && i + 2 <= n && ne < ICON_MAXENTRIES; i += 2 + (unsigned long)w * h) {
+		w = p[i];
+		h = p[i + 1];
+		if (w == 0 || h == 0 || w >= 16384 || h >= 16384 || (unsigned long)w * h > n - i - 2)
+			break;
+		e[ne].w = w;
+		e[ne].h = h;
+		e[ne].src = p + i + 2;
+		e[ne].argb = NULL;
+		e[ne].pm = None;
+		e[ne].hashed = 0;
+		ne++;
+	}
+
+	for (k = 0; k < ICON_SIZES; k++) {
+		if ((j = iconpick(e, ne, sizes[k])) < 0)
+			break;
+		if (e[j].w <= e[j].h) {
+			ich = sizes[k];
+			icw = MAX(1, e[j].w * sizes[k] / e[j].h);
+		} else {
+			icw = sizes[k];
+			ich = MAX(1, e[j].h * sizes[k] / e[j].w);
+		}
+		*icons[k] = iconget(&e[j], icw, ich);
+		*ws[k] = icw;
+		*hs[k] = ich;
+	}
+	for (k = 0; k < ICON_SIZES; k++)
+		iconrelease(old[k]);
+	for (k = 0; k < ne; k++)
+		if (e[k].pm)
+			XFreePixmap(dpy, e[k].pm);
+	if (p)
+		XFree(p);
+}
@@ -579,6 +579,50 @@ ipc_parse_get_dwm_client(const char *msg, Window *win)
   return 0;
 }
 
+/**
+ * Parse an IPC_TYPE_DUMP_TRACE message from a client. This function extracts
+ * the file the trace should be written to, if one was given.
+ *
+ * Returns 0 if message was successfully parsed
+ * Returns -1 otherwise
+ */
+static int
+ipc_parse_dump_trace(const char *msg, char *path, size_t size)
+{
+  char error_buffer[100];
+
+  yajl_val parent = yajl_tree_parse(msg, error_buffer, 100);
+
+  if (parent == NULL) {
+    fputs("Failed to parse message from client\n", stderr);
+    fprintf(stderr, "%s\n", error_buffer);
+    return -1;
+  }
+
+  // Format:
+  // {
+  //   "path": "<file>"   (optional)
+  // }
+  const char *path_path[] = {"path", 0};
+  yajl_val path_val = yajl_tree_get(parent, path_path, yajl_t_string);
+
+  static unsigned int dumps = 0;
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+
+  // The default lives in the user's private runtime dir, and tracedump()
+  // creates files exclusively, so a new name is needed for every dump
+  if (!dir || !*dir) dir = "/tmp";
+  if (path_val != NULL)
+    snprintf(path, size, "%s", YAJL_GET_STRING(path_val));
+  else
+    snprintf(path, size, "%s/dwm-trace-%d-%u.json", dir, (int)getpid(),
+             dumps++);
+
+  yajl_tree_free(parent);
+
+  return 0;
+}
+
 /**
  * Called when an IPC_TYPE_RUN_COMMAND message is received from a client. This
  * function parses, executes the given command, and prepares a reply message to
@@ -757,6 +801,61 @@ ipc_get_dwm_clients(IPCClient *ipc_client, const char *msg, const Monitor *mons)
   return 0;
 }
 
+/**
+ * Called when an IPC_TYPE_GET_STATS message is received from a client. It
+ * prepares a JSON reply with the latency histograms and counters kept by
+ * metrics.c.
+ */
+static void
+ipc_get_stats(IPCClient *c)
+{
+  yajl_gen gen;
+  ipc_reply_init_message(&gen);
+
+  dump_stats(gen);
+
+  ipc_reply_prepare_send_message(gen, c, IPC_TYPE_GET_STATS);
+}
+
+/**
+ * Called when an IPC_TYPE_DUMP_TRACE message is received from a client. It
+ * writes the in-memory trace as chrome trace JSON and replies with the file
+ * and the number of events written.
+ *
+ * Returns 0 if the trace was written
+ * Returns -1 otherwise
+ */
+static int
+ipc_dump_trace(IPCClient *c, const char *msg)
+{
+  char path[PATH_MAX];
+  int n;
+
+  if (ipc_parse_dump_trace(msg, path, sizeof(path)) < 0) {
+    ipc_prepare_reply_failure(c, IPC_TYPE_DUMP_TRACE, "Failed to parse message");
+    return -1;
+  }
+
+  if ((n = tracedump(path)) < 0) {
+    ipc_prepare_reply_failure(c, IPC_TYPE_DUMP_TRACE, "Cannot write %s: %s",
+                              path, strerror(errno));
+    return -1;
+  }
+
+  yajl_gen gen;
+  ipc_reply_init_message(&gen);
+
+  // clang-format off
+  YMAP(
+    YSTR("path"); YSTR(path);
+    YSTR("events"); YINT(n);
+  )
+  // clang-format on
+
+  ipc_reply_prepare_send_message(gen, c, IPC_TYPE_DUMP_TRACE);
+  return 0;
+}
+
 /**
  * Called when an IPC_TYPE_SUBSCRIBE message is received from a client. It
  * subscribes/unsubscribes the client from the specified event and replies with
@@ -1127,10 +1226,10 @@ ipc_send_events(Monitor *mons, Monitor **lastselmon, Monitor *selmon)
   for (Monitor *m = mons; m; m = m->next) {
     unsigned int urg = 0, occ = 0, tagset = 0;
 
-    for (Client *c = m->clients; c; c = c->next) {
-      occ |= c->tags;
-
-      if (c->isurgent) urg |= c->tags;
+    // Maintained by attach/detach/setclienttags/setclienturgent in dwm.c
+    for (int i = 0; i < 32; i++) {
+      if (m->tagclients[i]) occ |= 1u << i;
+      if (m->tagurgent[i]) urg |= 1u << i;
     }
     tagset = m->tagset[m->seltags];
 
@@ -1212,6 +1311,10 @@ ipc_handle_client_epoll_event(struct epoll_event *ev, Monitor *mons,
       if (ipc_get_dwm_client(c, msg, mons) < 0) return -1;
     } else if (msg_type == IPC_TYPE_GET_DWM_CLIENTS) {
       if (ipc_get_dwm_clients(c, msg, mons) < 0) return -1;
+    } else if (msg_type == IPC_TYPE_GET_STATS) {
+      ipc_get_stats(c);
+    } else if (msg_type == IPC_TYPE_DUMP_TRACE) {
+      if (ipc_dump_trace(c, msg) < 0) return -1;
     } else if (msg_type == IPC_TYPE_SUBSCRIBE) {
       if (ipc_subscribe(c, msg) < 0) return -1;
     } else {
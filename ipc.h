@@ -24,7 +24,9 @@ typedef enum IPCMessageType {
   IPC_TYPE_GET_DWM_CLIENT = 4,
   IPC_TYPE_GET_DWM_CLIENTS = 7,
   IPC_TYPE_SUBSCRIBE = 5,
-  IPC_TYPE_EVENT = 6
+  IPC_TYPE_EVENT = 6,
+  IPC_TYPE_GET_STATS = 8,
+  IPC_TYPE_DUMP_TRACE = 9
 } IPCMessageType;
 
 typedef enum IPCEvent {
@@ -0,0 +1,359 @@
+/* latency metrics, answered over ipc as IPC_TYPE_GET_STATS (dwm-msg get_stats).
+ *
+ * every histogram counts durations in power of two microsecond buckets:
+ * bucket i holds samples below 2^i us, the last one everything slower.
+ * recording is a clock read and a few additions, so it is always on.  each
+ * sample also becomes a complete event in the trace (trace.c).
+ *
+ * switcher frames additionally keep their last FRAME_SAMPLES durations, one
+ * ring with and one without previews, for exact percentiles.  the draw
+ * calls only queue requests, with DWM_FRAMESYNC set in the environment a
+ * frame also waits for the server to finish them, which is what
+ * bench/switcher.sh measures.
+ *
+ * included from dwm.c after config.h, the layout functions named below
+ * come from there.
+ */
+
+#define METRICS_BUCKETS 21 /* up to ~1s */
+
+typedef struct {
+	const char *name;
+	int cat; /* trace category the samples are also recorded under */
+	unsigned long count;
+	unsigned long long sum, max; /* us */
+	unsigned long buckets[METRICS_BUCKETS];
+} Histogram;
+
+typedef struct {
+	void (*arrange)(Monitor *);
+	Histogram h;
+} LayoutMetrics;
+
+typedef struct {
+	void (*arrange)(Container *);
+	Histogram h;
+} ContainerMetrics;
+
+static const char *eventnames[LASTEvent] = {
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[ClientMessage] = "ClientMessage",
+	[ConfigureRequest] = "ConfigureRequest",
+	[ConfigureNotify] = "ConfigureNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[EnterNotify] = "EnterNotify",
+	[Expose] = "Expose",
+	[FocusIn] = "FocusIn",
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[MappingNotify] = "MappingNotify",
+	[MapRequest] = "MapRequest",
+	[MotionNotify] = "MotionNotify",
+	[PropertyNotify] = "PropertyNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[UnmapNotify] = "UnmapNotify",
+};
+
+static Histogram eventmetrics[LASTEvent];
+static LayoutMetrics layoutmetrics[] = {
+	{ tile,              { "tile", TraceArrange } },
+	{ tile2,             { "tile2", TraceArrange } },
+	{ tile3,             { "tile3", TraceArrange } },
+	{ tile4,             { "tile4", TraceArrange } },
+	{ tile5,             { "tile5", TraceArrange } },
+	{ tile6,             { "tile6", TraceArrange } },
+	{ tile7,             { "tile7", TraceArrange } },
+	{ monocle,           { "monocle", TraceArrange } },
+	{ doublepage,        { "doublepage", TraceArrange } },
+	{ gaplessgrid,       { "gaplessgrid", TraceArrange } },
+	{ gapgrid,           { "gapgrid", TraceArrange } },
+	{ gapgridsorted,     { "gapgridsorted", TraceArrange } },
+	{ gapgridsortedneat, { "gapgridsortedneat", TraceArrange } },
+	{ NULL,              { "other", TraceArrange } }, /* keep last */
+};
+static ContainerMetrics containermetrics[] = {
+	{ container_layout_tile,   { "container_layout_tile", TraceArrange } },
+	{ container_layout_tile_v, { "container_layout_tile_v", TraceArrange } },
+	{ container_layout_mosaic, { "container_layout_mosaic", TraceArrange } },
+	{ container_layout_full,   { "container_layout_full", TraceArrange } },
+	{ NULL,                    { "other", TraceArrange } }, /* keep last */
+};
+static Histogram drawbarmetrics = { "drawbar", TraceDraw };
+static Histogram drawswitchermetrics = { "drawswitcher", TraceDraw };
+static Histogram batchmetrics = { "batch", TraceX };
+static unsigned long long metricsstart;
+
+#define FRAME_SAMPLES 4096
+
+typedef struct {
+	unsigned long n; /* taken so far, the ring holds the last FRAME_SAMPLES */
+	unsigned int us[FRAME_SAMPLES];
+} FrameSamples;
+
+static FrameSamples framesamples[2]; /* plain, with previews */
+static int framesync = -1;
+
+static unsigned long long
+metricsnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+metricsrecord(Histogram *h, unsigned long long start)
+{
+	unsigned long long d = metricsnow() - start;
+	int i;
+
+	for (i = 0; i < METRICS_BUCKETS - 1 && d >= 1ULL << i; i++);
+	h->buckets[i]++;
+	h->count++;
+	h->sum += d;
+	if (d > h->max)
+		h->max = d;
+	tracecomplete(h->cat, h->name, start, d);
+}
+
+/* a switcher frame that started at start is on screen */
+void
+metricsframe(int preview, unsigned long long start)
+{
+	FrameSamples *f = &framesamples[!!preview];
+	unsigned long long d;
+
+	if (framesync < 0)
+		framesync = getenv("DWM_FRAMESYNC") != NULL;
+	if (framesync)
+		XSync(dpy, False);
+	d = metricsnow() - start;
+	f->us[f->n++ % FRAME_SAMPLES] = d > UINT_MAX ? UINT_MAX : d;
+}
+
+static int
+uintcmp(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+metricsdumpframes(yajl_gen gen, const FrameSamples *f)
+{
+	static unsigned int sorted[FRAME_SAMPLES];
+	size_t n = MIN(f->n, FRAME_SAMPLES);
+
+	memcpy(sorted, f->us, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), uintcmp);
+	// clang-format off
+	YMAP(
+		YSTR("frames"); YINT(f->n);
+		YSTR("window"); YINT(n);
+		YSTR("p50_us"); YINT(n ? sorted[n / 2] : 0);
+		YSTR("p99_us"); YINT(n ? sorted[n * 99 / 100] : 0);
+		YSTR("max_us"); YINT(n ? sorted[n - 1] : 0);
+	)
+	// clang-format on
+}
+
+void
+metricsevent(int type, unsigned long long start)
+{
+	Histogram *h;
+
+	if (type < 0 || type >= LASTEvent)
+		return;
+	h = &eventmetrics[type];
+	if (!h->name) {
+		h->name = eventnames[type] ? eventnames[type] : "unknown";
+		h->cat = TraceX;
+	}
+	metricsrecord(h, start);
+}
+
+void
+metricslayout(void (*arrange)(Monitor *), unsigned long long start)
+{
+	LayoutMetrics *l;
+
+	for (l = layoutmetrics; l->arrange && l->arrange != arrange; l++);
+	metricsrecord(&l->h, start);
+}
+
+void
+metricscontainer(void (*arrange)(Container *), unsigned long long start)
+{
+	ContainerMetrics *l;
+
+	for (l = containermetrics; l->arrange && l->arrange != arrange; l++);
+	metricsrecord(&l->h, start);
+}
+
+static void
+metricsdumphist(yajl_gen gen, const Histogram *h)
+{
+	int i;
+
+	// clang-format off
+	YMAP(
+		YSTR("count"); YINT(h->count);
+		YSTR("total_us"); YINT(h->sum);
+		YSTR("max_us"); YINT(h->max);
+		YSTR("mean_us"); YDOUBLE(h->count ? (double)h->sum / h->count : 0);
+		YSTR("buckets_us"); YARR(
+			for (i = 0; i < METRICS_BUCKETS; i++) {
+				if (!h->buckets[i])
+					continue;
+				YARR(
+					YINT(i == METRICS_BUCKETS - 1 ? -1 : 1L << i);
+					YINT(h->buckets[i]);
+				)
+			}
+		)
+	)
+	// clang-format on
+}
+
+int
+dump_stats(yajl_gen gen)
+{
+	const char *name;
+	unsigned long textascii, texthits, textmisses;
+	unsigned long glyphhits, glyphlookups, glyphnomatch, fallbackfonts;
+	int i;
+
+	drw_fontset_stats(&textascii, &texthits, &textmisses);
+	drw_glyph_stats(&glyphhits, &glyphlookups, &glyphnomatch, &fallbackfonts);
+
+	// clang-format off
+	YMAP(
+		YSTR("uptime_us"); YINT(metricsnow() - metricsstart);
+		YSTR("events"); YMAP(
+			for (i = 0; i < LASTEvent; i++) {
+				if (!eventmetrics[i].count)
+					continue;
+				name = eventnames[i] ? eventnames[i] : "unknown";
+				YSTR(name);
+				metricsdumphist(gen, &eventmetrics[i]);
+			}
+		)
+		YSTR("batch"); metricsdumphist(gen, &batchmetrics);
+		YSTR("arrange"); YMAP(
+			for (i = 0; i < LENGTH(layoutmetrics); i++) {
+				if (!layoutmetrics[i].h.count)
+					continue;
+				YSTR(layoutmetrics[i].h.name);
+				metricsdumphist(gen, &layoutmetrics[i].h);
+			}
+		)
+		YSTR("container_arrange"); YMAP(
+			for (i = 0; i < LENGTH(containermetrics); i++) {
+				if (!containermetrics[i].h.count)
+					continue;
+				YSTR(containermetrics[i].h.name);
+				metricsdumphist(gen, &containermetrics[i].h);
+			}
+		)
+		YSTR("drawbar"); metricsdumphist(gen, &drawbarmetrics);
+		YSTR("bar_segments"); YMAP(
+			YSTR("drawn"); YINT(barsegsdrawn);
+			YSTR("kept"); YINT(barsegskept);
+		)
+		YSTR("drawswitcher"); metricsdumphist(gen, &drawswitchermetrics);
+		YSTR("switcher_frames"); YMAP(
+			YSTR("synced"); YBOOL(framesync > 0);
+			YSTR("plain"); metricsdumpframes(gen, &framesamples[0]);
+			YSTR("preview"); metricsdumpframes(gen, &framesamples[1]);
+		)
+		YSTR("x11"); YMAP(
+			YSTR("roundtrips"); YINT(roundtrips);
+			YSTR("requests"); YINT(NextRequest(dpy) - 1);
+			YSTR("property_batches"); YINT(propbatches);
+			YSTR("property_batched"); YINT(propfetches);
+		)
+		YSTR("switcher_preview"); YMAP(
+			YSTR("renders"); YINT(previewrenders);
+			YSTR("cached"); YINT(previewhits);
+		)
+		YSTR("text_extents"); YMAP(
+			YSTR("ascii"); YINT(textascii);
+			YSTR("cached"); YINT(texthits);
+			YSTR("measured"); YINT(textmisses);
+		)
+		YSTR("glyph_fonts"); YMAP(
+			YSTR("lookups"); YINT(glyphlookups);
+			YSTR("cached"); YINT(glyphhits);
+			YSTR("no_font"); YINT(glyphnomatch);
+			YSTR("fallback_fonts"); YINT(fallbackfonts);
+		)
+		YSTR("switcher_tiles"); YMAP(
+			YSTR("renders"); YINT(tilerenders);
+			YSTR("copied"); YINT(tilehits);
+		)
+		YSTR("composite"); YMAP(
+			YSTR("redirected"); YINT(redirectcount);
+			YSTR("redirected_bytes"); YINT(redirectbytes);
+			YSTR("budget_bytes"); YINT(previewbudget);
+			YSTR("redirects"); YINT(redirects);
+			YSTR("unredirect_budget"); YINT(unredirects[UnredirectBudget]);
+			YSTR("unredirect_fullscreen"); YINT(unredirects[UnredirectFullscreen]);
+			YSTR("unredirect_bypass"); YINT(unredirects[UnredirectBypass]);
+			YSTR("unredirect_unmapped"); YINT(unredirects[UnredirectUnmapped]);
+			YSTR("unredirect_gone"); YINT(unredirects[UnredirectGone]);
+		)
+		YSTR("thumbnails"); YMAP(
+			YSTR("captures"); YINT(thumbcaptures);
+			YSTR("delivered"); YINT(thumbdelivered);
+			YSTR("dropped"); YINT(thumbdropped);
+			YSTR("scale_total_us"); YINT(thumbscaleus);
+			YSTR("scale_max_us"); YINT(thumbscalemax);
+		)
+		YSTR("icons"); YMAP(
+			YSTR("fetches"); YINT(iconfetches);
+			YSTR("uploads"); YINT(iconuploads);
+			YSTR("cache_hits"); YINT(iconhits);
+			YSTR("cached"); YINT(iconcount);
+			YSTR("atlas_placed"); YINT(iconatlased);
+		)
+		YSTR("status_blocks"); YMAP(
+			YSTR("updates"); YINT(statusupdates);
+			YSTR("commands"); YINT(statusruns);
+			YSTR("statusbar_scans"); YINT(statusbarscans);
+			YSTR("statusbar_pidfd"); YBOOL(statusbarfd >= 0);
+		)
+		YSTR("processes"); YMAP(
+			YSTR("netlink"); YBOOL(proclive);
+			YSTR("events"); YINT(procevents);
+			YSTR("lookups"); YINT(proclookups);
+			YSTR("proc_reads"); YINT(procreads);
+			YSTR("rescans"); YINT(procrescans);
+		)
+		YSTR("spawns"); YMAP(
+			YSTR("spawns"); YINT(spawns);
+			YSTR("forked"); YINT(spawnforks);
+			YSTR("failed"); YINT(spawnfailed);
+			YSTR("total_us"); YINT(spawnus);
+			YSTR("max_us"); YINT(spawnmaxus);
+		)
+		YSTR("placement_memo"); YMAP(
+			YSTR("hits"); YINT(placementmemohits);
+			YSTR("misses"); YINT(placementmemomisses);
+		)
+		YSTR("dirty"); YMAP(
+			for (i = 0; i < DirtyLast; i++) {
+				YSTR(dirtynames[i]);
+				YMAP(
+					YSTR("marks"); YINT(dirtymarks[i]);
+					YSTR("flushes"); YINT(dirtyflushes[i]);
+				)
+			}
+		)
+	)
+	// clang-format on
+
+	return 0;
+}
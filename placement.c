@@ -0,0 +1,340 @@
+/* placement providers for tile7.
+ *
+ * A provider turns the launchparent graph of the containers on a tag into a
+ * spiral ordering (resort) and learns about containers the user moved by
+ * hand (place).  resort must answer right away: it returns 1 with
+ * resorted[] filled, or 0 to let tile7 fall back to the fixed spiral seats.
+ *
+ * nativeplacement runs smartwin.c in process.  httpplacement talks to
+ * smartwinserver.py at placementurl without ever blocking: resort starts a
+ * request and answers with the last ordering known for the tag, and when
+ * the reply comes in (or placementtimeout expires) the tag is arranged again.
+ *
+ * included from dwm.c after smartwin.c.
+ */
+
+#define PLACEMENT_PARAMSIZE 4096
+#define PLACEMENT_BACKOFF   1000 /* ms without requests after a failed one */
+
+typedef struct {
+	const char *name;
+	int usesselindex; /* whether selindex can change the ordering */
+	int (*resort)(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[]);
+	void (*place)(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n);
+} PlacementProvider;
+
+typedef struct {
+	int tag;
+	int n;
+	int ids[SMARTWIN_CELLS];
+} PlacementRequest;
+
+/* the last resort of a tag, reused while nothing it depends on changed */
+typedef struct {
+	int valid;
+	unsigned int generation;
+	unsigned long hash;
+	int n, selindex;
+	int launchparents[SMARTWIN_CELLS];
+	int ids[SMARTWIN_CELLS];
+	int ok;
+	int resorted[LENGTH(spiral_index)];
+} PlacementMemo;
+
+static int nativeresort(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[]);
+static void nativeplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n);
+static int httpresort(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[]);
+static void httpplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n);
+
+static const PlacementProvider nativeplacement = { "native", 0, nativeresort, nativeplace };
+static const PlacementProvider httpplacement = { "http", 1, httpresort, httpplace };
+static const PlacementProvider *placement = &nativeplacement;
+
+/* per tag: params of the last request sent, and the last ordering received
+ * as container ids (so it survives containers coming and going) */
+static char placementsent[SMARTWIN_MAXTAGS][PLACEMENT_PARAMSIZE];
+static char placementdone[SMARTWIN_MAXTAGS][PLACEMENT_PARAMSIZE];
+static int placementlast[SMARTWIN_MAXTAGS][LENGTH(spiral_index)];
+static int placementhaslast[SMARTWIN_MAXTAGS];
+static int placementinflight[SMARTWIN_MAXTAGS];
+static long placementfailtime;
+static int placementunsettled; /* the last resort answered for older params */
+
+static PlacementMemo placementmemo[SMARTWIN_MAXTAGS];
+static unsigned int placementgeneration;
+static unsigned long placementmemohits, placementmemomisses;
+
+/* containers were created, freed or reparented, or a provider learned
+ * something new: every memoized ordering is stale */
+void
+placementinvalidate(void)
+{
+	placementgeneration++;
+}
+
+static unsigned long
+placementhash(int tag, const int launchparents[], const int ids[], int n, int selindex)
+{
+	unsigned long h = 2166136261UL;
+	int i;
+
+#define FNV(v) (h = (h ^ (unsigned int)(v)) * 16777619UL)
+	FNV(tag);
+	FNV(n);
+	FNV(selindex);
+	for (i = 0; i < n; i++) {
+		FNV(ids[i]);
+		FNV(launchparents[i]);
+	}
+#undef FNV
+	return h;
+}
+
+int
+placementresort(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[])
+{
+	PlacementMemo *memo;
+	unsigned long h;
+
+	if (n <= 0 || n > SMARTWIN_CELLS || tag < 0 || tag >= SMARTWIN_MAXTAGS)
+		return placement->resort(tag, launchparents, ids, n, selindex, resorted);
+	if (!placement->usesselindex)
+		selindex = -1;
+
+	memo = &placementmemo[tag];
+	h = placementhash(tag, launchparents, ids, n, selindex);
+	if (memo->valid && memo->generation == placementgeneration && memo->hash == h
+	&& memo->n == n && memo->selindex == selindex
+	&& !memcmp(memo->ids, ids, n * sizeof(int))
+	&& !memcmp(memo->launchparents, launchparents, n * sizeof(int))) {
+		placementmemohits++;
+		memcpy(resorted, memo->resorted, sizeof(memo->resorted));
+		return memo->ok;
+	}
+
+	placementmemomisses++;
+	placementunsettled = 0;
+	memo->ok = placement->resort(tag, launchparents, ids, n, selindex, resorted);
+	/* a stand-in while a request is out or held back must be asked for
+	 * again, or the request would never be sent */
+	memo->valid = !placementunsettled;
+	memo->generation = placementgeneration;
+	memo->hash = h;
+	memo->n = n;
+	memo->selindex = selindex;
+	memcpy(memo->ids, ids, n * sizeof(int));
+	memcpy(memo->launchparents, launchparents, n * sizeof(int));
+	memcpy(memo->resorted, resorted, sizeof(memo->resorted));
+	tracelog(TracePlacement, "placementresort tag:%d hits:%lu misses:%lu", tag, placementmemohits, placementmemomisses);
+	return memo->ok;
+}
+
+void
+placementplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n)
+{
+	placement->place(tag, targetindex, targetpos, ids, n);
+	placementinvalidate();
+}
+
+static int
+nativeresort(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[])
+{
+	return smartwinresort2(tag, launchparents, ids, n, resorted);
+}
+
+static void
+nativeplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n)
+{
+	smartwinplace(tag, targetindex, targetpos, ids, n);
+}
+
+static int
+placementappend(char *buf, size_t size, const char *fmt, ...)
+{
+	size_t len = strlen(buf);
+	va_list ap;
+	int r;
+
+	va_start(ap, fmt);
+	r = vsnprintf(buf + len, size - len, fmt, ap);
+	va_end(ap);
+	return r >= 0 && (size_t)r < size - len;
+}
+
+/* same form body pyresort3 used to send */
+static int
+placementparams(char *buf, size_t size, int tag, const int launchparents[], const int ids[], int n, int selindex)
+{
+	int i, ok;
+
+	buf[0] = '\0';
+	ok = placementappend(buf, size, "tag=%d&launchparents=", tag);
+	for (i = 0; i < n && ok; i++)
+		ok = placementappend(buf, size, i ? ",%d" : "%d", launchparents[i]);
+	ok = ok && placementappend(buf, size, "&ids=");
+	for (i = 0; i < n && ok; i++)
+		ok = placementappend(buf, size, i ? ",%d" : "%d", ids[i]);
+	if (ok && selindex >= 0)
+		ok = placementappend(buf, size, "&selindex=%d", selindex);
+	return ok;
+}
+
+/* maps the ids of the last answer back onto the current indices.  containers
+ * the answer does not know about take the first free seats. */
+static void
+placementapplylast(int tag, const int ids[], int n, int resorted[])
+{
+	int i, j, k, seated[SMARTWIN_CELLS];
+
+	memset(seated, 0, sizeof(seated));
+	for (i = 0; i < LENGTH(spiral_index); i++) {
+		resorted[i] = -1;
+		if (placementlast[tag][i] < 0)
+			continue;
+		for (j = 0; j < n; j++)
+			if (ids[j] == placementlast[tag][i] && !seated[j]) {
+				resorted[i] = j;
+				seated[j] = 1;
+				break;
+			}
+	}
+	for (j = 0, k = 0; j < n; j++) {
+		if (seated[j])
+			continue;
+		for (; k < LENGTH(spiral_index) && resorted[k] >= 0; k++);
+		if (k == LENGTH(spiral_index))
+			break;
+		resorted[k] = j;
+	}
+}
+
+static void
+placementmove(int tag, int id, MXY pos)
+{
+	int i, from = -1, to = -1;
+
+	for (i = 0; i < LENGTH(spiral_index); i++) {
+		if (placementlast[tag][i] == id)
+			from = i;
+		if (spiral_index[i].row == pos.row && spiral_index[i].col == pos.col)
+			to = i;
+	}
+	if (to < 0 || from == to)
+		return;
+	if (from >= 0)
+		placementlast[tag][from] = placementlast[tag][to];
+	placementlast[tag][to] = id;
+}
+
+static void
+httpresortdone(int ok, struct HttpResponse *resp, void *arg)
+{
+	PlacementRequest *req = arg;
+	Monitor *m;
+	char *tok, *end;
+	int i, index;
+
+	placementinflight[req->tag] = 0;
+	if (!ok) {
+		placementfailtime = getcurrusec() / 1000;
+		placementinvalidate();
+		free(req);
+		return;
+	}
+	for (i = 0; i < LENGTH(spiral_index); i++)
+		placementlast[req->tag][i] = -1;
+	for (i = 0, tok = strtok(resp->content, ","); tok && i < LENGTH(spiral_index);
+			tok = strtok(NULL, ","), i++) {
+		index = strtol(tok, &end, 10);
+		if (end != tok && index >= 0 && index < req->n)
+			placementlast[req->tag][i] = req->ids[index];
+	}
+	placementhaslast[req->tag] = 1;
+	memcpy(placementdone[req->tag], placementsent[req->tag], PLACEMENT_PARAMSIZE);
+	placementinvalidate();
+
+	for (m = mons; m; m = m->next)
+		if (getcurtagindex(m) == req->tag && m->lt[m->sellt]->arrange == tile7)
+			arrange(m);
+	free(req);
+}
+
+static int
+httpresort(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[])
+{
+	char params[PLACEMENT_PARAMSIZE];
+	char url[256];
+	PlacementRequest *req;
+
+	if (n <= 0 || n > SMARTWIN_CELLS || tag < 0 || tag >= SMARTWIN_MAXTAGS)
+		return 0;
+	if (!placementparams(params, sizeof(params), tag, launchparents, ids, n, selindex))
+		return nativeresort(tag, launchparents, ids, n, selindex, resorted);
+
+	if (strcmp(params, placementdone[tag]) && !placementinflight[tag]
+	&& getcurrusec() / 1000 - placementfailtime >= PLACEMENT_BACKOFF) {
+		snprintf(url, sizeof(url), "%s/resort", placementurl);
+		req = ecalloc(1, sizeof(PlacementRequest));
+		req->tag = tag;
+		req->n = n;
+		memcpy(req->ids, ids, n * sizeof(int));
+		if (httppostasync(url, params, placementtimeout, httpresortdone, req)) {
+			placementinflight[tag] = 1;
+			memcpy(placementsent[tag], params, sizeof(params));
+		} else {
+			free(req);
+		}
+	}
+
+	placementunsettled = strcmp(params, placementdone[tag]) != 0;
+	/* until the server answers, keep the windows where they were */
+	if (!placementhaslast[tag])
+		return nativeresort(tag, launchparents, ids, n, selindex, resorted);
+	placementapplylast(tag, ids, n, resorted);
+	return 1;
+}
+
+static void
+httpplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n)
+{
+	char params[PLACEMENT_PARAMSIZE];
+	char url[256];
+	int i, ok;
+
+	nativeplace(tag, targetindex, targetpos, ids, n);
+	/* move the seats locally too so the windows do not jump back while the
+	 * server catches up */
+	if (placementhaslast[tag])
+		for (i = 0; i < n; i++)
+			placementmove(tag, ids[i], targetpos[i]);
+
+	params[0] = '\0';
+	ok = placementappend(params, sizeof(params), "tag=%d&targets=", tag);
+	for (i = 0; i < n && ok; i++)
+		ok = placementappend(params, sizeof(params), i ? ",%d|%d|%d|%d" : "%d|%d|%d|%d",
+				targetindex[i], targetpos[i].row, targetpos[i].col, ids[i]);
+	if (!ok)
+		return;
+	snprintf(url, sizeof(url), "%s/place", placementurl);
+	httppostasync(url, params, placementtimeout, NULL, NULL);
+	/* the next resort has to ask again */
+	placementdone[tag][0] = '\0';
+}
+
+void
+setupplacement(void)
+{
+	if (!placementurl || !*placementurl)
+		return;
+	if (httpasyncinit(epoll_fd) < 0) {
+		fputs("dwm: cannot set up placement requests, using the native engine\n", stderr);
+		return;
+	}
+	placement = &httpplacement;
+}
+
+void
+cleanupplacement(void)
+{
+	httpasynccleanup();
+}
@@ -0,0 +1,268 @@
+/* cached switcher previews.
+ *
+ * the switcher used to redirect the window, look up its format and create
+ * and free a window picture for every client on every redraw, and then had
+ * the server scale the full window into the switcher.  each client now keeps
+ * its window picture and a downscaled ARGB copy (c->preview) of the size it
+ * was last drawn at.  the copy is only rendered again when the damage
+ * extension reports that the window changed, so a redraw composites small
+ * cached pictures no matter how large the windows are.  without damage the
+ * copy is rendered on every redraw, which still saves the setup round-trips.
+ *
+ * a window has to stay redirected for its picture to have contents, which
+ * costs the server an offscreen pixmap per window.  only windows that had a
+ * preview taken are redirected, their pixmaps are kept below previewbudget
+ * bytes by unredirecting the least recently drawn ones, and fullscreen
+ * windows and those asking for _NET_WM_BYPASS_COMPOSITOR are never
+ * redirected.  an unredirected window keeps its last preview, which is
+ * scaled when the switcher asks for another size.  windows unmapped on
+ * hidden tags (unmaphidden) have no contents to redirect, their preview is
+ * brought up to date just before the unmap, or read back in software
+ * (thumb.c) if there was none.
+ *
+ * included from dwm.c.
+ */
+
+enum { UnredirectBudget, UnredirectFullscreen, UnredirectBypass,
+       UnredirectUnmapped, UnredirectGone, UnredirectLast }; /* why a window was unredirected */
+
+static int damageevent = -1; /* event base, -1 without the damage extension */
+static unsigned long previewrenders, previewhits;
+static unsigned long previewtick;
+static unsigned long redirectbytes, redirectcount, redirects;
+static unsigned long unredirects[UnredirectLast];
+
+static unsigned long
+redirectsize(Client *c)
+{
+	return (unsigned long)MAX(c->w, 1) * MAX(c->h, 1) * 4;
+}
+
+/* drops the window picture and the redirection, keeps c->preview */
+static void
+previewunredirect(Client *c, int why)
+{
+	if (!c->previewsrc)
+		return;
+	if (c->damage)
+		XDamageDestroy(dpy, c->damage);
+	XRenderFreePicture(dpy, c->previewsrc);
+	XCompositeUnredirectWindow(dpy, c->win, CompositeRedirectAutomatic);
+	c->damage = None;
+	c->previewsrc = None;
+	redirectbytes -= c->redirectbytes;
+	redirectcount--;
+	c->redirectbytes = 0;
+	unredirects[why]++;
+}
+
+/* unredirects the least recently drawn windows until bytes more fit */
+static void
+redirectevict(Client *keep, unsigned long bytes)
+{
+	Monitor *m;
+	Client *c, *lru;
+
+	while (redirectbytes && redirectbytes + bytes > previewbudget) {
+		lru = NULL;
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				if (c != keep && c->previewsrc && (!lru || c->previewused < lru->previewused))
+					lru = c;
+		if (!lru)
+			break;
+		previewunredirect(lru, UnredirectBudget);
+	}
+}
+
+void
+updatebypass(Client *c)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra;
+	unsigned char *p = NULL;
+
+	c->bypasscompositor = 0;
+	if (getprop(c->win, netatom[NetWMBypassCompositor], 1L, XA_CARDINAL,
+			&real, &format, &n, &extra, &p) == Success && p) {
+		/* 1 asks for bypass, 2 asks not to be bypassed */
+		c->bypasscompositor = n && *(long *)p == 1;
+		XFree(p);
+	}
+	if (c->bypasscompositor)
+		previewunredirect(c, UnredirectBypass);
+}
+
+void
+previewfullscreen(Client *c)
+{
+	previewunredirect(c, UnredirectFullscreen);
+}
+
+void
+setuppreview(void)
+{
+	int error;
+
+	if (!XDamageQueryExtension(dpy, &damageevent, &error))
+		damageevent = -1;
+}
+
+/* sets up what stays the same for the life of the window */
+static int
+previewsource(Client *c)
+{
+	XWindowAttributes wa;
+	XRenderPictFormat *format;
+	XRenderPictureAttributes pa;
+	unsigned long bytes;
+
+	if (c->previewsrc)
+		return 1;
+	if (c->isfullscreen || c->bypasscompositor || c->tagunmapped)
+		return 0;
+	roundtrips++;
+	if (!XGetWindowAttributes(dpy, c->win, &wa)
+	|| !(format = XRenderFindVisualFormat(dpy, wa.visual)))
+		return 0;
+	bytes = redirectsize(c);
+	redirectevict(c, bytes);
+	XCompositeRedirectWindow(dpy, c->win, CompositeRedirectAutomatic);
+	pa.subwindow_mode = IncludeInferiors;
+	c->previewsrc = XRenderCreatePicture(dpy, c->win, format, CPSubwindowMode, &pa);
+	c->previewsrcw = c->previewsrch = 0;
+	c->redirectbytes = bytes;
+	redirectbytes += bytes;
+	redirectcount++;
+	redirects++;
+	if (damageevent >= 0 && !c->damage)
+		c->damage = XDamageCreate(dpy, c->win, XDamageReportNonEmpty);
+	c->previewdirty = 1;
+	return 1;
+}
+
+static Picture
+previewcreate(int w, int h)
+{
+	Pixmap pm;
+	Picture pic;
+
+	pm = XCreatePixmap(dpy, root, w, h, 32);
+	pic = XRenderCreatePicture(dpy, pm,
+		XRenderFindStandardFormat(dpy, PictStandardARGB32), 0, NULL);
+	/* the picture keeps the pixmap alive */
+	XFreePixmap(dpy, pm);
+	return pic;
+}
+
+/* the last preview taken while c was redirected, scaled to w x h */
+static Picture
+previewstale(Client *c, int w, int h)
+{
+	Picture pic;
+
+	if (!c->preview || (c->previeww == w && c->previewh == h))
+		return c->preview;
+	pic = previewcreate(w, h);
+	drw_resize_picture(drw, c->preview, c->previeww, c->previewh, w, h);
+	XRenderComposite(dpy, PictOpSrc, c->preview, None, pic, 0, 0, 0, 0, 0, 0, w, h);
+	XRenderFreePicture(dpy, c->preview);
+	c->preview = pic;
+	c->previeww = w;
+	c->previewh = h;
+	c->previewgen++;
+	previewrenders++;
+	return pic;
+}
+
+/* the preview of c at w x h, rendered again only if the window was damaged
+ * or the size changed */
+Picture
+previewget(Client *c, int w, int h)
+{
+	if (w <= 0 || h <= 0 || c->w <= 0 || c->h <= 0)
+		return None;
+	c->previewused = ++previewtick;
+	if (!previewsource(c))
+		return previewstale(c, w, h);
+
+	if (c->preview && (c->previeww != w || c->previewh != h)) {
+		XRenderFreePicture(dpy, c->preview);
+		c->preview = None;
+	}
+	if (!c->preview) {
+		c->preview = previewcreate(w, h);
+		c->previeww = w;
+		c->previewh = h;
+		c->previewdirty = 1;
+	}
+	/* the transform scales from the window to the tile, either may change */
+	if (c->previewsrcw != c->w || c->previewsrch != c->h
+	|| c->previewsrctw != w || c->previewsrcth != h) {
+		drw_resize_picture(drw, c->previewsrc, c->w, c->h, w, h);
+		c->previewsrcw = c->w;
+		c->previewsrch = c->h;
+		c->previewsrctw = w;
+		c->previewsrcth = h;
+		c->previewdirty = 1;
+		redirectbytes += redirectsize(c) - c->redirectbytes;
+		c->redirectbytes = redirectsize(c);
+		redirectevict(c, 0);
+	}
+	if (c->previewdirty || damageevent < 0) {
+		/* cleared first, what is drawn from here on reports again */
+		if (c->damage)
+			XDamageSubtract(dpy, c->damage, None, None);
+		XRenderComposite(dpy, PictOpSrc, c->previewsrc, None, c->preview,
+			0, 0, 0, 0, 0, 0, w, h);
+		c->previewdirty = 0;
+		c->previewgen++;
+		previewrenders++;
+	} else {
+		previewhits++;
+	}
+	return c->preview;
+}
+
+/* c is about to be unmapped and lose its contents, keep what it shows now */
+void
+previewunmap(Client *c)
+{
+	if (c->previewsrc && c->preview)
+		previewget(c, c->previeww, c->previewh);
+	else if (!c->preview)
+		thumbcapture(c);
+	previewunredirect(c, UnredirectUnmapped);
+}
+
+void
+previewfree(Client *c)
+{
+	if (!c->previewsrc && !c->preview)
+		return;
+	/* the window may be gone already, and its damage with it */
+	XSetErrorHandler(xerrordummy);
+	previewunredirect(c, UnredirectGone);
+	if (c->preview)
+		XRenderFreePicture(dpy, c->preview);
+	XSync(dpy, False);
+	XSetErrorHandler(xerror);
+	c->preview = None;
+}
+
+void
+damagenotify(XEvent *e)
+{
+	XDamageNotifyEvent *ev = (XDamageNotifyEvent *)e;
+	Client *c;
+
+	/* NonEmpty reports once until the damage is cleared, which previewget()
+	 * does when it renders, so a window drawing all the time costs one
+	 * event per preview drawn rather than one per frame */
+	if (!(c = wintoclient(ev->drawable)) || c->previewdirty)
+		return;
+	c->previewdirty = 1;
+	if (c->mon->switcher && isswitcherpreview)
+		markdirty(c->mon, DirtySwitcher);
+}
@@ -0,0 +1,381 @@
+/* process table.
+ *
+ * stacking a window with the terminal it was started from walks its
+ * parents, and opening a terminal in the directory of the selected one
+ * looks for the shell under it.  both used to read /proc for every step,
+ * the second one the stat file of every process on the system.
+ *
+ * the table maps pid to parent, children and name and is kept current from the
+ * kernel's process events (NETLINK_CONNECTOR, CN_IDX_PROC) in the epoll
+ * set, after reading /proc once.  the events need CAP_NET_ADMIN; without
+ * them, and until the kernel confirmed the subscription, the lookups read
+ * /proc as before, the children from /proc/<pid>/task/<pid>/children.
+ *
+ * included from dwm.c.
+ */
+
+#include <sys/socket.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <linux/cn_proc.h>
+
+#define PROC_BUCKETS 1024
+
+typedef struct ProcEntry ProcEntry;
+struct ProcEntry {
+	pid_t pid, ppid;
+	char comm[16]; /* empty until asked for after an exec */
+	ProcEntry *next;          /* in the bucket */
+	ProcEntry *kids, *sibling; /* children, while the parent is known */
+};
+
+static ProcEntry *procbuckets[PROC_BUCKETS];
+static int procfd = -1, procepollfd = -1;
+static int proclive; /* the table follows the events */
+static unsigned long procevents, proclookups, procreads, procrescans;
+
+/* reads pid's parent and name from /proc/<pid>/stat, 0 if it is gone */
+static int
+procreadstat(pid_t pid, pid_t *ppid, char comm[16])
+{
+	char buf[512], *s, *e;
+	FILE *fp;
+	size_t n;
+
+	procreads++;
+	snprintf(buf, sizeof(buf), "/proc/%d/stat", (int)pid);
+	if (!(fp = fopen(buf, "r")))
+		return 0;
+	n = fread(buf, 1, sizeof(buf) - 1, fp);
+	fclose(fp);
+	buf[n] = '\0';
+	/* the name is in parentheses and may hold anything, even ") " */
+	if (!(s = strchr(buf, '(')) || !(e = strrchr(s, ')')))
+		return 0;
+	if (comm)
+		snprintf(comm, 16, "%.*s", (int)(e - s - 1), s + 1);
+	return sscanf(e + 1, " %*c %d", ppid) == 1;
+}
+
+static ProcEntry *
+procfind(pid_t pid)
+{
+	ProcEntry *p;
+
+	for (p = procbuckets[pid % PROC_BUCKETS]; p && p->pid != pid; p = p->next);
+	return p;
+}
+
+static void
+procunlink(ProcEntry *p)
+{
+	ProcEntry **pp, *parent;
+
+	if (!(parent = procfind(p->ppid)))
+		return;
+	for (pp = &parent->kids; *pp && *pp != p; pp = &(*pp)->sibling);
+	if (*pp)
+		*pp = p->sibling;
+	p->sibling = NULL;
+}
+
+static void
+proclink(ProcEntry *p)
+{
+	ProcEntry *parent;
+
+	if ((parent = procfind(p->ppid)) && parent != p) {
+		p->sibling = parent->kids;
+		parent->kids = p;
+	}
+}
+
+static ProcEntry *
+procadd(pid_t pid, pid_t ppid)
+{
+	ProcEntry *p;
+
+	if ((p = procfind(pid))) {
+		procunlink(p);
+	} else {
+		p = ecalloc(1, sizeof(ProcEntry));
+		p->pid = pid;
+		p->next = procbuckets[pid % PROC_BUCKETS];
+		procbuckets[pid % PROC_BUCKETS] = p;
+	}
+	p->ppid = ppid;
+	p->comm[0] = '\0';
+	proclink(p);
+	return p;
+}
+
+static void
+procdel(pid_t pid)
+{
+	ProcEntry **pp, *p, *kid, *init;
+
+	for (pp = &procbuckets[pid % PROC_BUCKETS]; *pp && (*pp)->pid != pid; pp = &(*pp)->next);
+	if (!(p = *pp))
+		return;
+	procunlink(p);
+	*pp = p->next;
+	/* orphans go to init, or a subreaper the events do not tell about */
+	init = procfind(1);
+	while ((kid = p->kids)) {
+		p->kids = kid->sibling;
+		kid->ppid = 1;
+		kid->sibling = NULL;
+		if (init && init != kid) {
+			kid->sibling = init->kids;
+			init->kids = kid;
+		}
+	}
+	free(p);
+}
+
+static void
+procclear(void)
+{
+	ProcEntry *p, *next;
+	int i;
+
+	for (i = 0; i < PROC_BUCKETS; i++) {
+		for (p = procbuckets[i]; p; p = next) {
+			next = p->next;
+			free(p);
+		}
+		procbuckets[i] = NULL;
+	}
+}
+
+/* fills the table from /proc, after subscribing so nothing falls between */
+static void
+procscan(void)
+{
+	struct dirent *de;
+	ProcEntry *p;
+	DIR *dir;
+	pid_t pid, ppid;
+	char comm[16], *end;
+	int i;
+
+	procclear();
+	procrescans++;
+	if (!(dir = opendir("/proc")))
+		return;
+	while ((de = readdir(dir))) {
+		pid = strtol(de->d_name, &end, 10);
+		if (*end || pid <= 0 || !procreadstat(pid, &ppid, comm))
+			continue;
+		p = procadd(pid, ppid);
+		strcpy(p->comm, comm);
+	}
+	closedir(dir);
+	/* parents read after their children */
+	for (i = 0; i < PROC_BUCKETS; i++)
+		for (p = procbuckets[i]; p; p = p->next)
+			p->kids = p->sibling = NULL;
+	for (i = 0; i < PROC_BUCKETS; i++)
+		for (p = procbuckets[i]; p; p = p->next)
+			proclink(p);
+}
+
+static int
+procsubscribe(enum proc_cn_mcast_op op)
+{
+	char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nl = (struct nlmsghdr *)buf;
+	struct cn_msg *cn = NLMSG_DATA(nl);
+
+	memset(buf, 0, sizeof(buf));
+	nl->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+	nl->nlmsg_type = NLMSG_DONE;
+	nl->nlmsg_pid = getpid();
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(op);
+	memcpy(cn->data, &op, sizeof(op));
+	return send(procfd, buf, nl->nlmsg_len, 0) == (ssize_t)nl->nlmsg_len;
+}
+
+static void
+procstop(void)
+{
+	if (procfd >= 0) {
+		epoll_ctl(procepollfd, EPOLL_CTL_DEL, procfd, NULL);
+		close(procfd);
+	}
+	procfd = -1;
+	proclive = 0;
+	procclear();
+}
+
+void
+setupproc(int epollfd)
+{
+	struct sockaddr_nl sa;
+	struct epoll_event ev;
+
+	procepollfd = epollfd;
+	if ((procfd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_CONNECTOR)) < 0)
+		return;
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = CN_IDX_PROC;
+	if (bind(procfd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+	|| !procsubscribe(PROC_CN_MCAST_LISTEN)) {
+		close(procfd);
+		procfd = -1;
+		return;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = procfd;
+	epoll_ctl(epollfd, EPOLL_CTL_ADD, procfd, &ev);
+	/* live once the kernel acknowledges the subscription */
+}
+
+void
+cleanupproc(void)
+{
+	procstop();
+}
+
+int
+procownsfd(int fd)
+{
+	return fd >= 0 && fd == procfd;
+}
+
+static void
+procevent(struct proc_event *pe)
+{
+	ProcEntry *p;
+
+	procevents++;
+	switch (pe->what) {
+	case PROC_EVENT_NONE:
+		/* the answer to the subscription */
+		if (pe->event_data.ack.err) {
+			procstop();
+			return;
+		}
+		if (!proclive) {
+			proclive = 1;
+			procscan();
+		}
+		break;
+	case PROC_EVENT_FORK:
+		if (pe->event_data.fork.child_pid == pe->event_data.fork.child_tgid)
+			procadd(pe->event_data.fork.child_tgid, pe->event_data.fork.parent_tgid);
+		break;
+	case PROC_EVENT_EXEC:
+		if ((p = procfind(pe->event_data.exec.process_tgid)))
+			p->comm[0] = '\0';
+		break;
+	case PROC_EVENT_COMM:
+		if (pe->event_data.comm.process_pid == pe->event_data.comm.process_tgid
+		&& (p = procfind(pe->event_data.comm.process_tgid)))
+			snprintf(p->comm, sizeof(p->comm), "%.15s", pe->event_data.comm.comm);
+		break;
+	case PROC_EVENT_EXIT:
+		if (pe->event_data.exit.process_pid == pe->event_data.exit.process_tgid)
+			procdel(pe->event_data.exit.process_tgid);
+		break;
+	default:
+		break;
+	}
+}
+
+void
+prochandle(struct epoll_event *ev)
+{
+	char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nl;
+	struct cn_msg *cn;
+	ssize_t n;
+
+	while (procfd >= 0 && (n = recv(procfd, buf, sizeof(buf), 0)) != 0) {
+		if (n < 0) {
+			/* events were dropped, the table cannot be trusted */
+			if (errno == ENOBUFS && proclive)
+				procscan();
+			else if (errno != EAGAIN && errno != EINTR)
+				procstop();
+			if (errno != EINTR)
+				return;
+			continue;
+		}
+		for (nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, n); nl = NLMSG_NEXT(nl, n)) {
+			if (nl->nlmsg_type == NLMSG_ERROR || nl->nlmsg_type == NLMSG_NOOP)
+				continue;
+			cn = NLMSG_DATA(nl);
+			if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+				continue;
+			procevent((struct proc_event *)cn->data);
+			if (procfd < 0)
+				return;
+		}
+	}
+}
+
+/* the parent of pid, 0 if it is not known */
+pid_t
+procppid(pid_t pid)
+{
+	ProcEntry *p;
+	pid_t ppid;
+
+	proclookups++;
+	if (proclive)
+		return (p = procfind(pid)) ? p->ppid : 0;
+	return procreadstat(pid, &ppid, NULL) ? ppid : 0;
+}
+
+/* the name of pid into comm, 0 if it is not known */
+int
+proccomm(pid_t pid, char comm[16])
+{
+	ProcEntry *p;
+	pid_t ppid;
+
+	proclookups++;
+	if (!proclive)
+		return procreadstat(pid, &ppid, comm);
+	if (!(p = procfind(pid)))
+		return 0;
+	if (!p->comm[0] && !procreadstat(pid, &ppid, p->comm))
+		return 0;
+	strcpy(comm, p->comm);
+	return 1;
+}
+
+/* a child of pid, 0 if there is none */
+pid_t
+procchild(pid_t pid)
+{
+	ProcEntry *p;
+	char buf[64];
+	FILE *fp;
+	int child = 0;
+
+	proclookups++;
+	if (proclive)
+		return (p = procfind(pid)) && p->kids ? p->kids->pid : 0;
+	/* children of the main thread, which is what forks in a terminal */
+	procreads++;
+	snprintf(buf, sizeof(buf), "/proc/%d/task/%d/children", (int)pid, (int)pid);
+	if ((fp = fopen(buf, "r"))) {
+		if (fscanf(fp, "%d", &child) != 1)
+			child = 0;
+		fclose(fp);
+		return child;
+	}
+	/* kernels without CONFIG_PROC_CHILDREN */
+	procscan();
+	if ((p = procfind(pid)) && p->kids)
+		child = p->kids->pid;
+	procclear();
+	return child;
+}
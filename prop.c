@@ -0,0 +1,278 @@
+/* batched window property reads.
+ *
+ * manage() used to read a dozen properties of a new window one blocking
+ * XGetWindowProperty at a time.  propprefetch() sends all the requests at
+ * once over the xcb connection underneath Xlib and collects the replies
+ * together, so the whole set costs a single round-trip.  getprop() is a
+ * drop-in for XGetWindowProperty that answers from those replies and only
+ * asks the server for what was not prefetched.  Results are handed out in
+ * Xlib's layout (format 32 as longs, strings nul terminated) and are freed
+ * with XFree like the ones they replace.
+ *
+ * only one window is cached at a time and the cache must be dropped with
+ * propdrop() once the caller stops being the only reader, i.e. before the
+ * window can change its properties behind our back.
+ *
+ * included from dwm.c.
+ */
+
+#define PROP_MAX    16
+#define PROP_LENGTH 0x1fffffff /* in 32 bit units, as much as there is */
+
+typedef struct {
+	Atom atom;
+	xcb_get_property_reply_t *reply; /* NULL if the request failed */
+} PropEntry;
+
+static Window propwin = None;
+static PropEntry props[PROP_MAX];
+static int nprops;
+static unsigned long propfetches, propbatches;
+
+void
+propdrop(void)
+{
+	int i;
+
+	for (i = 0; i < nprops; i++)
+		free(props[i].reply);
+	nprops = 0;
+	propwin = None;
+}
+
+void
+propprefetch(Window w, const Atom atoms[], int n)
+{
+	xcb_connection_t *conn = XGetXCBConnection(dpy);
+	xcb_get_property_cookie_t cookies[PROP_MAX];
+	xcb_generic_error_t *err;
+	int i;
+
+	propdrop();
+	if (n > PROP_MAX)
+		n = PROP_MAX;
+	/* everything queued by Xlib so far has to go out before our requests */
+	XFlush(dpy);
+	for (i = 0; i < n; i++)
+		cookies[i] = xcb_get_property(conn, 0, w, atoms[i], XCB_GET_PROPERTY_TYPE_ANY, 0, PROP_LENGTH);
+	for (i = 0; i < n; i++) {
+		err = NULL;
+		props[i].atom = atoms[i];
+		/* errors are ours to free, the window may be gone already */
+		props[i].reply = xcb_get_property_reply(conn, cookies[i], &err);
+		free(err);
+	}
+	nprops = n;
+	propwin = w;
+	propfetches += n;
+	propbatches++;
+	roundtrips++;
+}
+
+static PropEntry *
+propfind(Window w, Atom prop)
+{
+	int i;
+
+	if (w != propwin || w == None)
+		return NULL;
+	for (i = 0; i < nprops; i++)
+		if (props[i].atom == prop)
+			return &props[i];
+	return NULL;
+}
+
+/* XGetWindowProperty(dpy, w, prop, 0, len, False, req, ...) */
+int
+getprop(Window w, Atom prop, long len, Atom req, Atom *real, int *format,
+		unsigned long *n, unsigned long *extra, unsigned char **p)
+{
+	PropEntry *e;
+	xcb_get_property_reply_t *r;
+	unsigned long i, nitems, unit;
+	unsigned char *data;
+
+	if (!(e = propfind(w, prop))) {
+		roundtrips++;
+		return XGetWindowProperty(dpy, w, prop, 0L, len, False, req,
+			real, format, n, extra, p);
+	}
+	if (!(r = e->reply))
+		return BadWindow;
+
+	*real = r->type;
+	*format = r->format;
+	*n = *extra = 0;
+	*p = NULL;
+	if (r->type == None || (req != AnyPropertyType && req != r->type)) {
+		*format = r->type == None ? 0 : r->format;
+		*extra = r->type == None ? 0 : xcb_get_property_value_length(r);
+		return Success;
+	}
+
+	unit = r->format / 8;
+	if (!unit)
+		return Success;
+	nitems = xcb_get_property_value_length(r) / unit;
+	if (len >= 0 && len < PROP_LENGTH && nitems * unit > (unsigned long)len * 4)
+		nitems = (unsigned long)len * 4 / unit;
+	*extra = xcb_get_property_value_length(r) - nitems * unit;
+	data = xcb_get_property_value(r);
+
+	switch (r->format) {
+	case 8:
+		*p = ecalloc(nitems + 1, 1);
+		memcpy(*p, data, nitems);
+		break;
+	case 16:
+		*p = ecalloc(nitems + 1, sizeof(short));
+		for (i = 0; i < nitems; i++)
+			((short *)*p)[i] = ((uint16_t *)data)[i];
+		break;
+	case 32:
+		*p = ecalloc(nitems + 1, sizeof(long));
+		for (i = 0; i < nitems; i++)
+			((long *)*p)[i] = ((uint32_t *)data)[i];
+		break;
+	default:
+		return BadValue;
+	}
+	*n = nitems;
+	return Success;
+}
+
+/* XGetTextProperty */
+int
+proptext(Window w, Atom prop, XTextProperty *text)
+{
+	unsigned long extra;
+
+	text->value = NULL;
+	if (getprop(w, prop, PROP_LENGTH, AnyPropertyType, &text->encoding,
+			&text->format, &text->nitems, &extra, &text->value) != Success
+	|| text->encoding == None) {
+		if (text->value)
+			XFree(text->value);
+		text->value = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+/* XGetClassHint */
+int
+propclasshint(Window w, XClassHint *ch)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra, len;
+	unsigned char *p = NULL;
+
+	if (getprop(w, XA_WM_CLASS, PROP_LENGTH, XA_STRING, &real, &format, &n, &extra, &p) != Success
+	|| real != XA_STRING || format != 8) {
+		if (p)
+			XFree(p);
+		return 0;
+	}
+	len = strlen((char *)p);
+	ch->res_name = ecalloc(len + 1, 1);
+	memcpy(ch->res_name, p, len);
+	if (len + 1 < n) {
+		ch->res_class = ecalloc(n - len, 1);
+		memcpy(ch->res_class, p + len + 1, n - len - 1);
+	} else {
+		ch->res_class = ecalloc(1, 1);
+	}
+	XFree(p);
+	return 1;
+}
+
+/* XGetTransientForHint */
+int
+proptransient(Window w, Window *trans)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra;
+	unsigned char *p = NULL;
+	int ok = 0;
+
+	*trans = None;
+	if (getprop(w, XA_WM_TRANSIENT_FOR, 1L, XA_WINDOW, &real, &format, &n, &extra, &p) == Success
+	&& real == XA_WINDOW && format == 32 && n) {
+		*trans = *(Window *)p;
+		ok = 1;
+	}
+	if (p)
+		XFree(p);
+	return ok;
+}
+
+/* XGetWMHints */
+XWMHints *
+propwmhints(Window w)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra;
+	long *p = NULL;
+	XWMHints *wmh = NULL;
+
+	if (getprop(w, XA_WM_HINTS, 9L, XA_WM_HINTS, &real, &format, &n, &extra, (unsigned char **)&p) == Success
+	&& real == XA_WM_HINTS && format == 32 && n >= 8 && (wmh = XAllocWMHints())) {
+		wmh->flags = p[0];
+		wmh->input = p[1] ? True : False;
+		wmh->initial_state = p[2];
+		wmh->icon_pixmap = p[3];
+		wmh->icon_window = p[4];
+		wmh->icon_x = p[5];
+		wmh->icon_y = p[6];
+		wmh->icon_mask = p[7];
+		wmh->window_group = n >= 9 ? p[8] : 0;
+	}
+	if (p)
+		XFree(p);
+	return wmh;
+}
+
+/* XGetWMNormalHints */
+int
+propsizehints(Window w, XSizeHints *size, long *supplied)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra;
+	long *p = NULL;
+
+	if (getprop(w, XA_WM_NORMAL_HINTS, 18L, XA_WM_SIZE_HINTS, &real, &format, &n, &extra, (unsigned char **)&p) != Success
+	|| real != XA_WM_SIZE_HINTS || format != 32 || n < 15) {
+		if (p)
+			XFree(p);
+		return 0;
+	}
+	size->flags = p[0] & (USPosition|USSize|PAllHints);
+	size->x = p[1];
+	size->y = p[2];
+	size->width = p[3];
+	size->height = p[4];
+	size->min_width = p[5];
+	size->min_height = p[6];
+	size->max_width = p[7];
+	size->max_height = p[8];
+	size->width_inc = p[9];
+	size->height_inc = p[10];
+	size->min_aspect.x = p[11];
+	size->min_aspect.y = p[12];
+	size->max_aspect.x = p[13];
+	size->max_aspect.y = p[14];
+	*supplied = USPosition|USSize|PAllHints;
+	if (n >= 18) {
+		size->flags |= p[0] & (PBaseSize|PWinGravity);
+		size->base_width = p[15];
+		size->base_height = p[16];
+		size->win_gravity = p[17];
+		*supplied |= PBaseSize|PWinGravity;
+	}
+	XFree(p);
+	return 1;
+}
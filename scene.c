@@ -0,0 +1,68 @@
+/* retained switcher tiles.
+ *
+ * every client keeps the last rendering of its switcher tile in a pixmap,
+ * and every tag the last rendering of its whole area, each together with a
+ * key hashed from everything that went into it: geometry, selection,
+ * colours, texts, icon and preview.  a frame recomputes the keys, which is
+ * cheap, and copies tiles whose key did not change instead of drawing them
+ * again, so moving the selection renders the two tiles involved.
+ *
+ * included from dwm.c.
+ */
+
+static unsigned long tilehits, tilerenders;
+
+static unsigned long
+tilemix(unsigned long h, unsigned long v)
+{
+	return (h ^ v) * 1099511628211UL;
+}
+
+static unsigned long
+tilemixstr(unsigned long h, const char *s)
+{
+	for (; *s; s++)
+		h = tilemix(h, (unsigned char)*s);
+	return tilemix(h, 0);
+}
+
+/* copies the tile to x, y of the drawable if it still shows key */
+int
+tilefetch(Tile *t, unsigned long key, int x, int y, unsigned int w, unsigned int h)
+{
+	if (!t->pm || t->key != key || t->w != w || t->h != h)
+		return 0;
+	drw_flush(drw);
+	XCopyArea(dpy, t->pm, drw->drawable, drw->gc, 0, 0, w, h, x, y);
+	tilehits++;
+	return 1;
+}
+
+/* keeps what was just drawn at x, y as the tile showing key */
+void
+tilestore(Tile *t, unsigned long key, int x, int y, unsigned int w, unsigned int h)
+{
+	if (!w || !h)
+		return;
+	if (t->pm && (t->w != w || t->h != h)) {
+		XFreePixmap(dpy, t->pm);
+		t->pm = None;
+	}
+	if (!t->pm)
+		t->pm = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	drw_flush(drw);
+	XCopyArea(dpy, drw->drawable, t->pm, drw->gc, x, y, w, h, 0, 0);
+	t->w = w;
+	t->h = h;
+	t->key = key;
+	tilerenders++;
+}
+
+void
+tilefree(Tile *t)
+{
+	if (t->pm)
+		XFreePixmap(dpy, t->pm);
+	t->pm = None;
+	t->key = 0;
+}
@@ -0,0 +1,253 @@
+/* native port of smartwin.py (resort2, resort3, place).
+ *
+ * tile7 used to POST the launchparent graph to smartwinserver.py and read
+ * the spiral ordering back.  The same greedy placement runs here, so the
+ * result is available without leaving the event loop.  Orderings match
+ * smartwin.py for every layout the python version can represent (the grid is
+ * 11x11, python raises IndexError once the search runs off the grid, here
+ * those cells are simply skipped).
+ *
+ * included from dwm.c after spiral_index, which is the trace used to turn
+ * the filled grid back into an ordering.
+ */
+
+#define SMARTWIN_NLEVEL  6
+#define SMARTWIN_CENTER  (SMARTWIN_NLEVEL - 1)
+#define SMARTWIN_DIM     (2 * SMARTWIN_NLEVEL - 1)
+#define SMARTWIN_CELLS   (SMARTWIN_DIM * SMARTWIN_DIM)
+#define SMARTWIN_MAXTAGS 32
+
+typedef struct {
+	int index; /* position in the ids[] of the call that filled it */
+	int i, j;  /* absolute grid coordinates */
+	int id;
+} SmartwinFilled;
+
+/* lastfilledlistdict in smartwin.py */
+static SmartwinFilled smartwinlastfilled[SMARTWIN_MAXTAGS][SMARTWIN_CELLS];
+static int smartwinlastfilledn[SMARTWIN_MAXTAGS];
+
+static double smartwinmat[SMARTWIN_CELLS][SMARTWIN_CELLS];
+
+/* create_adjacent_matrix_from2: every window is related to the windows up
+ * its launch chain, exp(1-j) for the j-th ancestor */
+static void
+smartwinadjacent(const int launchparents[], int n)
+{
+	int chain[SMARTWIN_CELLS + 1];
+	int i, j, k, len, last, found;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			smartwinmat[i][j] = 0.00001;
+
+	for (i = 0; i < n; i++) {
+		chain[0] = i;
+		len = 1;
+		last = i;
+		for (k = 0; k < n; k++) {
+			if (launchparents[last] < 0 || launchparents[last] >= n)
+				break;
+			for (found = 0, j = 0; j < len && !found; j++)
+				found = chain[j] == launchparents[last];
+			if (found)
+				break;
+			chain[len++] = launchparents[last];
+			last = launchparents[last];
+		}
+		for (j = 1; j < len; j++) {
+			smartwinmat[chain[0]][chain[j]] = exp(1 - j);
+			smartwinmat[chain[j]][chain[0]] = exp(1 - j);
+		}
+	}
+}
+
+static int
+smartwinhasdecimal(double f)
+{
+	return f - (int)f > 0;
+}
+
+/* greedy spiral fill shared by resort2 and resort3.  filled[0..*filledn) are
+ * already seated, remain[] lists the indices still to place in order. */
+static void
+smartwinfill(const int ids[], int posmat[SMARTWIN_DIM][SMARTWIN_DIM],
+		SmartwinFilled filled[], int *filledn, int remain[], int remainn)
+{
+	static const int signs[4][2] = {{-1, 1}, {-1, -1}, {1, 1}, {1, -1}};
+	int round, rounds, level, levels, k, g, s, r, f, mi, mj, di, dj;
+	double score, maxscore, root;
+	SmartwinFilled maxitem;
+
+	for (rounds = remainn, round = 0; round < rounds; round++) {
+		maxscore = -INFINITY;
+		maxitem.index = -1;
+		root = (sqrt(*filledn) - 1) / 2;
+		levels = (int)root + 1 + smartwinhasdecimal(root);
+		for (level = 0; level <= levels; level++)
+			for (k = 0; k <= level; k++)
+				for (g = 0; g <= level; g++)
+					for (s = 0; s < 4; s++) {
+						mi = SMARTWIN_CENTER + signs[s][0] * k;
+						mj = SMARTWIN_CENTER + signs[s][1] * g;
+						if (mi < 0 || mi >= SMARTWIN_DIM || mj < 0 || mj >= SMARTWIN_DIM)
+							continue;
+						if (posmat[mi][mj] >= 0)
+							continue;
+						for (r = 0; r < remainn; r++) {
+							score = 0;
+							for (f = 0; f < *filledn; f++) {
+								di = mi - filled[f].i;
+								dj = mj - filled[f].j;
+								score += (1 / sqrt(di * di + dj * dj))
+									* smartwinmat[remain[r]][filled[f].index];
+							}
+							if (score > maxscore) {
+								maxscore = score;
+								maxitem.index = remain[r];
+								maxitem.i = mi;
+								maxitem.j = mj;
+								maxitem.id = ids[remain[r]];
+							}
+						}
+					}
+		if (maxitem.index < 0)
+			break;
+		filled[(*filledn)++] = maxitem;
+		for (r = 0; r < remainn && remain[r] != maxitem.index; r++);
+		for (remainn--; r < remainn; r++)
+			remain[r] = remain[r + 1];
+		posmat[maxitem.i][maxitem.j] = maxitem.index;
+	}
+}
+
+static void
+smartwintrace(int posmat[SMARTWIN_DIM][SMARTWIN_DIM], int resorted[])
+{
+	int i, x, y;
+
+	for (i = 0; i < LENGTH(spiral_index); i++) {
+		x = spiral_index[i].row + SMARTWIN_CENTER;
+		y = spiral_index[i].col + SMARTWIN_CENTER;
+		if (x < 0 || y < 0 || x >= SMARTWIN_DIM || y >= SMARTWIN_DIM)
+			break;
+		resorted[i] = posmat[x][y];
+	}
+}
+
+static void
+smartwininit(int posmat[SMARTWIN_DIM][SMARTWIN_DIM], int remain[], int n)
+{
+	int i, j;
+
+	for (i = 0; i < SMARTWIN_DIM; i++)
+		for (j = 0; j < SMARTWIN_DIM; j++)
+			posmat[i][j] = -1;
+	for (i = 0; i < n; i++)
+		remain[i] = i;
+}
+
+/* resort2: containers keep the cell they had last time on this tag (matched
+ * by id), the rest are placed greedily around them.  resorted[] receives
+ * LENGTH(spiral_index) container indices in spiral order, -1 for holes. */
+int
+smartwinresort2(int tag, const int launchparents[], const int ids[], int n, int resorted[])
+{
+	int posmat[SMARTWIN_DIM][SMARTWIN_DIM];
+	int remain[SMARTWIN_CELLS];
+	SmartwinFilled filled[SMARTWIN_CELLS];
+	SmartwinFilled *last;
+	int i, j, r, filledn = 0, remainn = n, lastn;
+
+	if (n <= 0 || n > SMARTWIN_CELLS || tag < 0 || tag >= SMARTWIN_MAXTAGS)
+		return 0;
+	smartwinadjacent(launchparents, n);
+	smartwininit(posmat, remain, n);
+
+	last = smartwinlastfilled[tag];
+	lastn = smartwinlastfilledn[tag];
+	if (lastn > 0) {
+		for (i = 0; i < n; i++)
+			for (j = 0; j < lastn; j++)
+				if (last[j].id == ids[i]) {
+					filled[filledn].index = i;
+					filled[filledn].i = last[j].i;
+					filled[filledn].j = last[j].j;
+					filled[filledn].id = ids[i];
+					filledn++;
+					for (r = 0; r < remainn && remain[r] != i; r++);
+					for (remainn--; r < remainn; r++)
+						remain[r] = remain[r + 1];
+					posmat[last[j].i][last[j].j] = i;
+					break;
+				}
+	} else {
+		filled[0].index = 0;
+		filled[0].i = filled[0].j = SMARTWIN_CENTER;
+		filled[0].id = ids[0];
+		filledn = 1;
+		for (remainn--, r = 0; r < remainn; r++)
+			remain[r] = r + 1;
+		posmat[SMARTWIN_CENTER][SMARTWIN_CENTER] = 0;
+	}
+
+	smartwinfill(ids, posmat, filled, &filledn, remain, remainn);
+
+	memcpy(last, filled, filledn * sizeof(SmartwinFilled));
+	smartwinlastfilledn[tag] = filledn;
+
+	smartwintrace(posmat, resorted);
+	return 1;
+}
+
+/* resort3: no memory, the selected container (selindex, -1 for none) is
+ * seated first */
+int
+smartwinresort3(int tag, const int launchparents[], const int ids[], int n, int selindex, int resorted[])
+{
+	int posmat[SMARTWIN_DIM][SMARTWIN_DIM];
+	int remain[SMARTWIN_CELLS];
+	SmartwinFilled filled[SMARTWIN_CELLS];
+	int i, filledn = 0;
+
+	if (n <= 0 || n > SMARTWIN_CELLS)
+		return 0;
+	smartwinadjacent(launchparents, n);
+	smartwininit(posmat, remain, n);
+	if (selindex >= 0 && selindex < n) {
+		for (i = selindex; i > 0; i--)
+			remain[i] = remain[i - 1];
+		remain[0] = selindex;
+	}
+
+	smartwinfill(ids, posmat, filled, &filledn, remain, n);
+
+	smartwintrace(posmat, resorted);
+	return 1;
+}
+
+/* place: the user moved containers by hand, remember the new cells so the
+ * next resort2 on this tag keeps them there.  targetindex[] is matched
+ * against the index the container had when it was last filled. */
+void
+smartwinplace(int tag, const int targetindex[], const MXY targetpos[], const int ids[], int n)
+{
+	SmartwinFilled *last;
+	int i, p, lastn, used[SMARTWIN_CELLS];
+
+	if (n <= 0 || n > SMARTWIN_CELLS || tag < 0 || tag >= SMARTWIN_MAXTAGS)
+		return;
+	last = smartwinlastfilled[tag];
+	lastn = smartwinlastfilledn[tag];
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < lastn; i++)
+		for (p = 0; p < n; p++)
+			if (!used[p] && targetindex[p] == last[i].index) {
+				last[i].index = targetindex[p];
+				last[i].i = targetpos[p].row + SMARTWIN_CENTER;
+				last[i].j = targetpos[p].col + SMARTWIN_CENTER;
+				last[i].id = ids[p];
+				used[p] = 1;
+				break;
+			}
+}
@@ -0,0 +1,101 @@
+/* spawning commands.
+ *
+ * fork() copies the page tables of all of dwm, fonts, icons and imlib
+ * included, before the child gets to exec, and the copy-on-write faults
+ * after it land on dwm itself.  posix_spawn() in glibc and musl clones
+ * with CLONE_VM | CLONE_VFORK instead: the child runs on the parent's
+ * memory until it execs, so a command costs the same no matter how large
+ * dwm got.  the child starts its own session like before.  it does not
+ * get a chance to close the x connection, so that and the epoll fd are
+ * close-on-exec, like the fds the modules open.
+ *
+ * the StatusCmd blocks of status.c go the same way, with their output
+ * pipe put on stdout by a file action.
+ *
+ * spawnfork in config.h goes back to fork(), and so does a libc that does
+ * not know POSIX_SPAWN_SETSID (glibc before 2.26).  bench/spawn.c
+ * compares the two.
+ *
+ * included from dwm.c.
+ */
+
+#include <spawn.h>
+
+#ifndef POSIX_SPAWN_SETSID
+#define POSIX_SPAWN_SETSID 0x80 /* glibc and musl, hidden without _GNU_SOURCE */
+#endif
+
+extern char **environ;
+
+static unsigned long spawns, spawnforks, spawnfailed;
+static unsigned long long spawnus, spawnmaxus;
+
+static pid_t
+spawnforked(char *const argv[], int out, char *const envp[])
+{
+	pid_t pid;
+
+	spawnforks++;
+	if ((pid = fork()) == 0) {
+		if (dpy)
+			close(ConnectionNumber(dpy));
+		setsid();
+		if (out >= 0)
+			dup2(out, STDOUT_FILENO);
+		environ = (char **)envp;
+		execvp(argv[0], argv);
+		fprintf(stderr, "dwm: execvp %s", argv[0]);
+		perror(" failed");
+		exit(EXIT_SUCCESS);
+	}
+	return pid;
+}
+
+/* runs argv in a session of its own with the environment envp and, unless
+ * out is -1, out as its stdout.  returns its pid or -1 */
+pid_t
+spawnout(char *const argv[], int out, char *const envp[])
+{
+	posix_spawnattr_t attr;
+	posix_spawn_file_actions_t fa;
+	sigset_t none;
+	unsigned long long start, dur;
+	pid_t pid = -1;
+	int err;
+
+	start = thumbnow();
+	spawns++;
+	if (spawnfork || posix_spawnattr_init(&attr)) {
+		pid = spawnforked(argv, out, envp);
+	} else {
+		sigemptyset(&none);
+		posix_spawnattr_setsigmask(&attr, &none);
+		posix_spawn_file_actions_init(&fa);
+		/* dup2 clears close-on-exec on the copy */
+		if (out >= 0)
+			posix_spawn_file_actions_adddup2(&fa, out, STDOUT_FILENO);
+		if (posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK)) {
+			/* older libc, the flag is unknown */
+			pid = spawnforked(argv, out, envp);
+		} else if ((err = posix_spawnp(&pid, argv[0], &fa, &attr, argv, envp))) {
+			/* unlike fork(), the exec failing is reported here */
+			fprintf(stderr, "dwm: execvp %s failed: %s\n", argv[0], strerror(err));
+			spawnfailed++;
+			pid = -1;
+		}
+		posix_spawn_file_actions_destroy(&fa);
+		posix_spawnattr_destroy(&attr);
+	}
+	dur = thumbnow() - start;
+	spawnus += dur;
+	if (dur > spawnmaxus)
+		spawnmaxus = dur;
+	return pid;
+}
+
+/* runs argv in a session of its own, returns its pid or -1 */
+pid_t
+spawncmd(char *const argv[])
+{
+	return spawnout(argv, -1, environ);
+}
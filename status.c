@@ -0,0 +1,400 @@
+/* status blocks run by dwm itself.
+ *
+ * with usestatusblocks set the status text is no longer read from the root
+ * window name, which a shell loop has to keep setting with a fork of
+ * xsetroot per tick.  each of statusblocks is updated on its own interval,
+ * aligned to the wall clock, from one timerfd in the epoll set:
+ * StatusTime formats the clock, StatusFile reads the first line of a file
+ * and StatusCmd the first line a shell command prints, through a pipe in
+ * the epoll set so dwm never waits for it, started with spawnout()
+ * (spawn.c) rather than a fork of dwm.  the status is only rebuilt
+ * when a block's text changed, and drawbar() then repaints the segments
+ * that changed (bar.c).
+ *
+ * every block is preceded by the control character of its position, 1 for
+ * the first, so clicks find it the way they find statuscmd blocks.  a click
+ * runs a StatusCmd block again with BUTTON set to the button pressed and
+ * updates any other block at once.
+ *
+ * without usestatusblocks an external program (STATUSBAR) sets the status
+ * and gets the clicks as signals.  it is found by reading /proc at startup,
+ * when it exits and on a click while it is not known, and then held
+ * through a pidfd in the epoll set, so its exit is seen at once.  a click
+ * signals it through the pidfd and never forks.
+ *
+ * included from dwm.c after config.h.
+ */
+
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+
+#define STATUSBLOCK_LEN 64
+#define STATUSBLOCKS    MIN(LENGTH(statusblocks), 31) /* control characters */
+
+typedef struct {
+	char text[STATUSBLOCK_LEN];
+	char out[STATUSBLOCK_LEN]; /* what the running command printed so far */
+	size_t outlen;
+	int fd;                    /* pipe from the running command, -1 */
+	unsigned long long due;    /* us since the epoch */
+} StatusState;
+
+static StatusState statusstates[LENGTH(statusblocks)];
+static int statustimerfd = -1, statusepollfd = -1;
+static unsigned long statusupdates, statusruns;
+static int statusbarfd = -1; /* pidfd of statuspid */
+static unsigned long statusbarscans;
+
+static unsigned long long
+statusnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the status text of the blocks, for updatestatus() */
+void
+statusjoin(char *text, size_t size)
+{
+	size_t i, n = 0;
+
+	text[0] = '\0';
+	for (i = 0; i < STATUSBLOCKS && n + 1 < size; i++) {
+		text[n++] = i + 1;
+		n += snprintf(text + n, size - n, "%s%s", i ? statusdelim : "", statusstates[i].text);
+		n = MIN(n, size - 1);
+	}
+	text[n] = '\0';
+}
+
+/* keeps the first line of s as the text of block i */
+static void
+statusset(int i, const char *s)
+{
+	char line[STATUSBLOCK_LEN];
+
+	snprintf(line, sizeof(line), "%.*s", (int)strcspn(s, "\n"), s);
+	statusupdates++;
+	if (!strcmp(line, statusstates[i].text))
+		return;
+	strcpy(statusstates[i].text, line);
+	updatestatus();
+}
+
+static void
+statusrun(int i, int button)
+{
+	StatusState *st = &statusstates[i];
+	struct epoll_event ev;
+	char b[20], **envp = environ, **e;
+	char *argv[] = { "/bin/sh", "-c", (char *)statusblocks[i].arg, NULL };
+	int fds[2], n;
+	pid_t pid;
+
+	if (st->fd >= 0) /* still running */
+		return;
+	if (pipe(fds) < 0)
+		return;
+	/* the child gets the write end as its stdout, nothing else keeps it */
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	if (button) {
+		/* environ with BUTTON set, dwm's own stays as it is */
+		for (n = 0; environ[n]; n++);
+		envp = ecalloc(n + 2, sizeof(char *));
+		for (e = environ, n = 0; *e; e++)
+			if (strncmp(*e, "BUTTON=", 7))
+				envp[n++] = *e;
+		snprintf(b, sizeof(b), "BUTTON=%d", button);
+		envp[n] = b;
+	}
+	pid = spawnout(argv, fds[1], envp);
+	if (envp != environ)
+		free(envp);
+	close(fds[1]);
+	if (pid < 0) {
+		close(fds[0]);
+		return;
+	}
+	statusruns++;
+	st->fd = fds[0];
+	st->outlen = 0;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = st->fd;
+	epoll_ctl(statusepollfd, EPOLL_CTL_ADD, st->fd, &ev);
+}
+
+static void
+statusupdate(int i, int button)
+{
+	char buf[STATUSBLOCK_LEN] = "";
+	struct tm tm;
+	time_t t;
+	FILE *fp;
+
+	switch (statusblocks[i].source) {
+	case StatusTime:
+		t = time(NULL);
+		localtime_r(&t, &tm);
+		strftime(buf, sizeof(buf), statusblocks[i].arg, &tm);
+		break;
+	case StatusFile:
+		if ((fp = fopen(statusblocks[i].arg, "r"))) {
+			if (!fgets(buf, sizeof(buf), fp))
+				buf[0] = '\0';
+			fclose(fp);
+		}
+		break;
+	case StatusCmd:
+		statusrun(i, button);
+		return;
+	}
+	statusset(i, buf);
+}
+
+/* arms the timer for the next block due */
+static void
+statusschedule(void)
+{
+	struct itimerspec its;
+	unsigned long long next = ULLONG_MAX;
+	int i;
+
+	for (i = 0; i < STATUSBLOCKS; i++)
+		next = MIN(next, statusstates[i].due);
+	memset(&its, 0, sizeof(its));
+	if (next != ULLONG_MAX) {
+		its.it_value.tv_sec = next / 1000000;
+		its.it_value.tv_nsec = next % 1000000 * 1000;
+	}
+	timerfd_settime(statustimerfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* the next multiple of the interval of block i after now */
+static unsigned long long
+statusnext(int i, unsigned long long now)
+{
+	unsigned long long every = statusblocks[i].interval * 1000000ULL;
+
+	return every ? (now / every + 1) * every : ULLONG_MAX;
+}
+
+/* if pid runs STATUSBAR, compared like pidof does, by the base name of argv[0] */
+static int
+isstatusbar(pid_t pid)
+{
+	char buf[64], *s, *c;
+	FILE *fp;
+	int r = 0;
+
+	snprintf(buf, sizeof(buf), "/proc/%d/cmdline", (int)pid);
+	if (!(fp = fopen(buf, "r")))
+		return 0;
+	if (fgets(buf, sizeof(buf), fp)) {
+		for (s = buf; (c = strchr(s, '/')); s = c + 1);
+		r = !strcmp(s, STATUSBAR);
+	}
+	fclose(fp);
+	return r;
+}
+
+static void
+statusbarlost(void)
+{
+	if (statusbarfd >= 0) {
+		epoll_ctl(statusepollfd, EPOLL_CTL_DEL, statusbarfd, NULL);
+		close(statusbarfd);
+	}
+	statusbarfd = -1;
+	statuspid = -1;
+}
+
+/* looks for the status program unless it is known.  only a click and the
+ * exit of the one known ask for this, a root name may just as well come
+ * from a shell loop, which would have /proc read for nothing */
+void
+statusbartrack(void)
+{
+	struct epoll_event ev;
+	struct dirent *de;
+	DIR *dir;
+	pid_t pid = 0;
+	char *end;
+
+	if (usestatusblocks || statuspid > 0)
+		return;
+	statusbarscans++;
+	if (!(dir = opendir("/proc")))
+		return;
+	while (!pid && (de = readdir(dir))) {
+		pid = strtol(de->d_name, &end, 10);
+		if (*end || pid <= 0 || !isstatusbar(pid))
+			pid = 0;
+	}
+	closedir(dir);
+	if (!pid)
+		return;
+	statuspid = pid;
+#ifdef SYS_pidfd_open
+	if ((statusbarfd = syscall(SYS_pidfd_open, pid, 0)) >= 0) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = statusbarfd;
+		epoll_ctl(statusepollfd, EPOLL_CTL_ADD, statusbarfd, &ev);
+	}
+#endif
+}
+
+/* queues sig with value v to the status program, like sigqueue(3) */
+void
+statusbarsignal(int sig, int v)
+{
+	union sigval sv;
+
+	statusbartrack();
+	if (statuspid <= 0)
+		return;
+	sv.sival_int = v;
+#ifdef SYS_pidfd_send_signal
+	if (statusbarfd >= 0) {
+		siginfo_t si;
+
+		memset(&si, 0, sizeof(si));
+		si.si_signo = sig;
+		si.si_code = SI_QUEUE;
+		si.si_pid = getpid();
+		si.si_uid = getuid();
+		si.si_value = sv;
+		/* ESRCH: it exited, the pidfd is readable and statushandle() will
+		 * see to it, closing it here would leave that event to an unknown fd */
+		syscall(SYS_pidfd_send_signal, statusbarfd, sig, &si, 0);
+		return;
+	}
+#endif
+	/* no pidfd, the pid may have been taken by something else */
+	if (!isstatusbar(statuspid)) {
+		statuspid = -1;
+		statusbartrack();
+		if (statuspid <= 0)
+			return;
+	}
+	sigqueue(statuspid, sig, sv);
+}
+
+void
+setupstatus(int epollfd)
+{
+	struct epoll_event ev;
+	unsigned long long now = statusnow();
+	int i;
+
+	statusepollfd = epollfd;
+	if (!usestatusblocks) {
+		statusbartrack();
+		return;
+	}
+	if ((statustimerfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		return;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = statustimerfd;
+	epoll_ctl(epollfd, EPOLL_CTL_ADD, statustimerfd, &ev);
+	for (i = 0; i < STATUSBLOCKS; i++) {
+		statusstates[i].fd = -1;
+		statusstates[i].due = statusnext(i, now);
+		statusupdate(i, 0);
+	}
+	statusschedule();
+}
+
+void
+cleanupstatus(void)
+{
+	int i;
+
+	for (i = 0; i < STATUSBLOCKS; i++)
+		if (statusstates[i].fd >= 0)
+			close(statusstates[i].fd);
+	if (statustimerfd >= 0)
+		close(statustimerfd);
+	statustimerfd = -1;
+	statusbarlost();
+}
+
+int
+statusownsfd(int fd)
+{
+	int i;
+
+	if (fd < 0)
+		return 0;
+	if (fd == statustimerfd || fd == statusbarfd)
+		return 1;
+	for (i = 0; i < STATUSBLOCKS; i++)
+		if (statusstates[i].fd == fd)
+			return 1;
+	return 0;
+}
+
+void
+statushandle(struct epoll_event *ev)
+{
+	StatusState *st;
+	unsigned long long now;
+	char buf[256];
+	uint64_t n;
+	ssize_t r;
+	size_t k;
+	int i;
+
+	if (ev->data.fd == statusbarfd) {
+		/* it exited, look once for one already started again, otherwise
+		 * the next click does */
+		statusbarlost();
+		statusbartrack();
+		return;
+	}
+	if (ev->data.fd == statustimerfd) {
+		if (read(statustimerfd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+			return;
+		now = statusnow();
+		for (i = 0; i < STATUSBLOCKS; i++) {
+			if (statusstates[i].due > now)
+				continue;
+			statusstates[i].due = statusnext(i, now);
+			statusupdate(i, 0);
+		}
+		statusschedule();
+		return;
+	}
+	for (i = 0; i < STATUSBLOCKS && statusstates[i].fd != ev->data.fd; i++);
+	if (i == STATUSBLOCKS)
+		return;
+	st = &statusstates[i];
+	/* what does not fit is read and dropped */
+	while ((r = read(st->fd, buf, sizeof(buf))) > 0) {
+		k = MIN((size_t)r, sizeof(st->out) - 1 - st->outlen);
+		memcpy(st->out + st->outlen, buf, k);
+		st->outlen += k;
+	}
+	if (r < 0 && errno == EAGAIN)
+		return;
+	epoll_ctl(statusepollfd, EPOLL_CTL_DEL, st->fd, NULL);
+	close(st->fd);
+	st->fd = -1;
+	st->out[st->outlen] = '\0';
+	statusset(i, st->out);
+}
+
+/* a click on the block at sig (see sigstatusbar) */
+void
+statusclick(int sig, int button)
+{
+	if (sig < 1 || sig > STATUSBLOCKS)
+		return;
+	statusupdate(sig - 1, button);
+}
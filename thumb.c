@@ -0,0 +1,341 @@
+/* software window thumbnails.
+ *
+ * a window that is about to lose its contents (tagcapture(), before
+ * anything is mapped over it) and has no switcher preview yet is read back
+ * once through MIT-SHM, which copies the pixels into a shared segment
+ * instead of the socket.  a worker thread box-filters it down to at most
+ * thumbsize pixels a side and hands the result back through an eventfd in
+ * the epoll set, where it is uploaded as the client's preview.  nothing but
+ * the read back waits for the server, and the worker never calls Xlib.
+ *
+ * the average is taken on premultiplied pixels, which is what 32 bit
+ * windows hold already; 24 bit windows get an opaque alpha.
+ *
+ * included from dwm.c.
+ */
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef struct ThumbJob ThumbJob;
+struct ThumbJob {
+	Window win;
+	XImage *img;
+	XShmSegmentInfo shm;
+	int opaque;
+	int w, h;          /* of the thumbnail */
+	uint32_t *out;     /* w * h ARGB, filled by the worker */
+	unsigned long long start, dur; /* us */
+	ThumbJob *next;
+};
+
+static int thumbshm; /* MIT-SHM is there */
+static int thumbfd = -1;
+static pthread_t thumbthread;
+static pthread_mutex_t thumblock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t thumbcond = PTHREAD_COND_INITIALIZER;
+static ThumbJob *thumbtodo, *thumbdone;
+static int thumbquit;
+static unsigned long thumbcaptures, thumbdelivered, thumbdropped;
+static unsigned long long thumbscaleus, thumbscalemax;
+
+static unsigned long long
+thumbnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* adds the channels of n pixels to sum[], in memory order (b, g, r, a) */
+static void
+thumbsumrow(const uint32_t *p, int n, uint32_t sum[4])
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc, wide = zero, v;
+	uint32_t lanes[4];
+	int end;
+
+	while (i + 4 <= n) {
+		/* each 16 bit lane takes two pixels per step, 512 pixels fit */
+		end = MIN(n, i + 512);
+		acc = zero;
+		for (; i + 4 <= end; i += 4) {
+			v = _mm_loadu_si128((const __m128i *)(p + i));
+			acc = _mm_add_epi16(acc, _mm_unpacklo_epi8(v, zero));
+			acc = _mm_add_epi16(acc, _mm_unpackhi_epi8(v, zero));
+		}
+		wide = _mm_add_epi32(wide, _mm_unpacklo_epi16(acc, zero));
+		wide = _mm_add_epi32(wide, _mm_unpackhi_epi16(acc, zero));
+	}
+	_mm_storeu_si128((__m128i *)lanes, wide);
+	sum[0] += lanes[0];
+	sum[1] += lanes[1];
+	sum[2] += lanes[2];
+	sum[3] += lanes[3];
+#endif
+	for (; i < n; i++) {
+		sum[0] += p[i] & 0xff;
+		sum[1] += p[i] >> 8 & 0xff;
+		sum[2] += p[i] >> 16 & 0xff;
+		sum[3] += p[i] >> 24;
+	}
+}
+
+/* box filter, every destination pixel is the mean of the source pixels
+ * under it.  stride is in pixels */
+static void
+thumbscale(const uint32_t *src, int sw, int sh, int stride,
+		uint32_t *dst, int dw, int dh, int opaque)
+{
+	uint32_t sum[4];
+	int x, y, yy, x0, x1, y0, y1, n;
+
+	for (y = 0; y < dh; y++) {
+		y0 = (long)y * sh / dh;
+		y1 = MAX((long)(y + 1) * sh / dh, y0 + 1);
+		for (x = 0; x < dw; x++) {
+			x0 = (long)x * sw / dw;
+			x1 = MAX((long)(x + 1) * sw / dw, x0 + 1);
+			sum[0] = sum[1] = sum[2] = sum[3] = 0;
+			for (yy = y0; yy < y1; yy++)
+				thumbsumrow(src + (size_t)yy * stride + x0, x1 - x0, sum);
+			n = (x1 - x0) * (y1 - y0);
+			dst[(size_t)y * dw + x] = (opaque ? 0xffu : (sum[3] + n / 2) / n) << 24
+				| (sum[2] + n / 2) / n << 16
+				| (sum[1] + n / 2) / n << 8
+				| (sum[0] + n / 2) / n;
+		}
+	}
+}
+
+static void *
+thumbworker(void *unused)
+{
+	ThumbJob *j;
+	unsigned long long start;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&thumblock);
+	for (;;) {
+		while (!thumbtodo && !thumbquit)
+			pthread_cond_wait(&thumbcond, &thumblock);
+		if (thumbquit)
+			break;
+		j = thumbtodo;
+		thumbtodo = j->next;
+		pthread_mutex_unlock(&thumblock);
+
+		start = thumbnow();
+		if ((j->out = malloc(sizeof(uint32_t) * j->w * j->h)))
+			thumbscale((uint32_t *)j->img->data, j->img->width, j->img->height,
+				j->img->bytes_per_line / 4, j->out, j->w, j->h, j->opaque);
+		j->dur = thumbnow() - start;
+
+		pthread_mutex_lock(&thumblock);
+		j->next = thumbdone;
+		thumbdone = j;
+		/* fails only when the counter is full, the loop wakes up anyway */
+		if (write(thumbfd, &one, sizeof(one)) < 0)
+			continue;
+	}
+	pthread_mutex_unlock(&thumblock);
+	return NULL;
+}
+
+static void
+thumbjobfree(ThumbJob *j)
+{
+	XShmDetach(dpy, &j->shm);
+	j->img->data = NULL;
+	XDestroyImage(j->img);
+	shmdt(j->shm.shmaddr);
+	free(j->out);
+	free(j);
+}
+
+void
+setupthumb(int epollfd)
+{
+	struct epoll_event ev;
+	int major, minor;
+	Bool pixmaps;
+
+	if (!XShmQueryVersion(dpy, &major, &minor, &pixmaps))
+		return;
+	if ((thumbfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		return;
+	if (pthread_create(&thumbthread, NULL, thumbworker, NULL)) {
+		close(thumbfd);
+		thumbfd = -1;
+		return;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = thumbfd;
+	epoll_ctl(epollfd, EPOLL_CTL_ADD, thumbfd, &ev);
+	thumbshm = 1;
+}
+
+void
+cleanupthumb(void)
+{
+	ThumbJob *j;
+
+	if (!thumbshm)
+		return;
+	pthread_mutex_lock(&thumblock);
+	thumbquit = 1;
+	pthread_cond_signal(&thumbcond);
+	pthread_mutex_unlock(&thumblock);
+	pthread_join(thumbthread, NULL);
+	while ((j = thumbtodo) || (j = thumbdone)) {
+		if (j == thumbtodo)
+			thumbtodo = j->next;
+		else
+			thumbdone = j->next;
+		thumbjobfree(j);
+	}
+	close(thumbfd);
+	thumbfd = -1;
+	thumbshm = 0;
+}
+
+int
+thumbownsfd(int fd)
+{
+	return fd >= 0 && fd == thumbfd;
+}
+
+/* reads c back and queues it for scaling, returns 0 if it could not */
+int
+thumbcapture(Client *c)
+{
+	XWindowAttributes wa;
+	ThumbJob *j;
+	int ok;
+
+	if (!thumbshm || c->w <= 0 || c->h <= 0)
+		return 0;
+	roundtrips++;
+	if (!XGetWindowAttributes(dpy, c->win, &wa) || wa.map_state != IsViewable
+	|| (wa.depth != 24 && wa.depth != 32))
+		return 0;
+	j = ecalloc(1, sizeof(ThumbJob));
+	j->img = XShmCreateImage(dpy, wa.visual, wa.depth, ZPixmap, NULL, &j->shm,
+		wa.width, wa.height);
+	if (!j->img || j->img->bits_per_pixel != 32) {
+		if (j->img)
+			XDestroyImage(j->img);
+		free(j);
+		return 0;
+	}
+	j->shm.shmid = shmget(IPC_PRIVATE, (size_t)j->img->bytes_per_line * j->img->height,
+		IPC_CREAT | 0600);
+	if (j->shm.shmid < 0 || (j->shm.shmaddr = shmat(j->shm.shmid, NULL, 0)) == (void *)-1) {
+		if (j->shm.shmid >= 0)
+			shmctl(j->shm.shmid, IPC_RMID, NULL);
+		XDestroyImage(j->img);
+		free(j);
+		return 0;
+	}
+	j->img->data = j->shm.shmaddr;
+	j->shm.readOnly = False;
+	XShmAttach(dpy, &j->shm);
+	/* the window may be gone already */
+	XSetErrorHandler(xerrordummy);
+	ok = XShmGetImage(dpy, c->win, j->img, 0, 0, AllPlanes);
+	roundtrips++;
+	XSync(dpy, False);
+	XSetErrorHandler(xerror);
+	/* goes away with the last detach */
+	shmctl(j->shm.shmid, IPC_RMID, NULL);
+	if (!ok) {
+		thumbjobfree(j);
+		return 0;
+	}
+
+	j->win = c->win;
+	j->opaque = wa.depth != 32;
+	if (wa.width >= wa.height) {
+		j->w = MIN(wa.width, thumbsize);
+		j->h = MAX(1, (long)wa.height * j->w / wa.width);
+	} else {
+		j->h = MIN(wa.height, thumbsize);
+		j->w = MAX(1, (long)wa.width * j->h / wa.height);
+	}
+	j->start = thumbnow();
+	thumbcaptures++;
+	pthread_mutex_lock(&thumblock);
+	j->next = thumbtodo;
+	thumbtodo = j;
+	pthread_cond_signal(&thumbcond);
+	pthread_mutex_unlock(&thumblock);
+	return 1;
+}
+
+static Picture
+thumbupload(ThumbJob *j)
+{
+	XImage *img;
+	Pixmap pm;
+	Picture pic;
+	GC gc;
+
+	pm = XCreatePixmap(dpy, root, j->w, j->h, 32);
+	gc = XCreateGC(dpy, pm, 0, NULL);
+	img = XCreateImage(dpy, NULL, 32, ZPixmap, 0, (char *)j->out, j->w, j->h, 32, 0);
+	XPutImage(dpy, pm, gc, img, 0, 0, 0, 0, j->w, j->h);
+	img->data = NULL; /* still j->out */
+	XDestroyImage(img);
+	XFreeGC(dpy, gc);
+	pic = XRenderCreatePicture(dpy, pm,
+		XRenderFindStandardFormat(dpy, PictStandardARGB32), 0, NULL);
+	XFreePixmap(dpy, pm);
+	return pic;
+}
+
+void
+thumbhandle(struct epoll_event *ev)
+{
+	ThumbJob *j, *done;
+	uint64_t n;
+	Client *c;
+
+	if (read(thumbfd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		return;
+	pthread_mutex_lock(&thumblock);
+	done = thumbdone;
+	thumbdone = NULL;
+	pthread_mutex_unlock(&thumblock);
+
+	while ((j = done)) {
+		done = j->next;
+		thumbscaleus += j->dur;
+		if (j->dur > thumbscalemax)
+			thumbscalemax = j->dur;
+		tracecomplete(TraceDraw, "thumbnail", j->start, thumbnow() - j->start);
+		/* a live preview is better than what we read back */
+		if (j->out && (c = wintoclient(j->win)) && !c->previewsrc && !c->preview) {
+			c->preview = thumbupload(j);
+			c->previeww = j->w;
+			c->previewh = j->h;
+			c->previewgen++;
+			thumbdelivered++;
+			if (c->mon->switcher && isswitcherpreview)
+				markdirty(c->mon, DirtySwitcher);
+		} else {
+			thumbdropped++;
+		}
+		thumbjobfree(j);
+	}
+}
@@ -0,0 +1,292 @@
+/* in-memory trace, exported as chrome trace json (chrome://tracing, perfetto).
+ *
+ * events go into a fixed ring and old ones are overwritten, nothing is
+ * formatted or written while dwm runs.  LOG_FORMAT keeps its printf
+ * interface but only stores the format pointer, the raw arguments and a
+ * copy of string arguments; the text is produced by tracedump(), which is
+ * reached over ipc (dwm-msg dump_trace [file]).  the slot is claimed with
+ * an atomic add so any thread may record.
+ *
+ * which categories are recorded is fixed at compile time by tracecategories
+ * in config.h.
+ */
+
+#define TRACE_SIZE   16384 /* events kept, power of two */
+#define TRACE_NARGS  8
+#define TRACE_STRLEN 32    /* string arguments of one event, together */
+
+typedef union {
+	long long i;
+	double f;
+} TraceArg;
+
+typedef struct {
+	unsigned long seq;     /* index + 1 once complete */
+	unsigned long long ts; /* ns */
+	unsigned long long dur;
+	const char *name;      /* the format for log events */
+	unsigned char cat, ph, nargs;
+	TraceArg args[TRACE_NARGS];
+	char str[TRACE_STRLEN];
+} TraceRecord;
+
+static const char *tracecatnames[TraceLast] = {
+	[TraceLog] = "log", [TraceX] = "event", [TraceArrange] = "arrange",
+	[TraceDraw] = "draw", [TracePlacement] = "placement",
+};
+
+static TraceRecord tracering[TRACE_SIZE];
+static unsigned long tracehead;
+
+static unsigned long long
+tracenow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static TraceRecord *
+traceclaim(unsigned long *seq)
+{
+	*seq = __atomic_fetch_add(&tracehead, 1, __ATOMIC_RELAXED);
+	return &tracering[*seq & (TRACE_SIZE - 1)];
+}
+
+static void
+tracepublish(TraceRecord *e, unsigned long seq)
+{
+	__atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/* a span that already happened, start and duration in us */
+void
+tracecomplete(int cat, const char *name, unsigned long long start, unsigned long long dur)
+{
+	TraceRecord *e;
+	unsigned long seq;
+
+	if (!(tracecategories & 1 << cat))
+		return;
+	e = traceclaim(&seq);
+	e->seq = 0;
+	e->ts = start * 1000;
+	e->dur = dur * 1000;
+	e->name = name;
+	e->cat = cat;
+	e->ph = 'X';
+	e->nargs = 0;
+	tracepublish(e, seq);
+}
+
+/* walks the conversions of fmt and stores the arguments they consume */
+static void
+tracelogv(int cat, const char *fmt, va_list ap)
+{
+	TraceRecord *e;
+	unsigned long seq;
+	const char *f, *s;
+	size_t used = 0, len;
+	int longs;
+
+	if (!(tracecategories & 1 << cat))
+		return;
+	e = traceclaim(&seq);
+	e->seq = 0;
+	e->ts = tracenow();
+	e->dur = 0;
+	e->name = fmt;
+	e->cat = cat;
+	e->ph = 'i';
+	e->nargs = 0;
+	for (f = fmt; *f && e->nargs < TRACE_NARGS; f++) {
+		if (*f != '%')
+			continue;
+		if (*++f == '%')
+			continue;
+		for (; *f && strchr("-+ #0123456789.", *f); f++);
+		for (longs = 0; *f && strchr("hlLqjzt", *f); f++)
+			longs += *f != 'h';
+		switch (*f) {
+		case 'd': case 'i': case 'c':
+			e->args[e->nargs++].i = longs ? va_arg(ap, long) : va_arg(ap, int);
+			break;
+		case 'u': case 'x': case 'X': case 'o':
+			e->args[e->nargs++].i = longs ? (long long)va_arg(ap, unsigned long)
+				: (long long)va_arg(ap, unsigned int);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			e->args[e->nargs++].f = va_arg(ap, double);
+			break;
+		case 'p':
+			e->args[e->nargs++].i = (long long)(uintptr_t)va_arg(ap, void *);
+			break;
+		case 's':
+			/* the string may not outlive the call, keep what fits */
+			s = va_arg(ap, const char *);
+			len = s && used < TRACE_STRLEN ? strnlen(s, TRACE_STRLEN - used - 1) : 0;
+			e->args[e->nargs++].i = used;
+			if (used < TRACE_STRLEN) {
+				if (len)
+					memcpy(e->str + used, s, len);
+				e->str[used + len] = '\0';
+				used += len + 1;
+			}
+			break;
+		default:
+			f--; /* unknown, print it verbatim */
+			break;
+		}
+		if (!*f)
+			break;
+	}
+	tracepublish(e, seq);
+}
+
+void
+tracelog(int cat, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	tracelogv(cat, fmt, ap);
+	va_end(ap);
+}
+
+void
+LOG(char *content, char *content2)
+{
+	LOG_FORMAT("%s%s", content, content2);
+}
+
+void
+LOG_FORMAT(char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	tracelogv(TraceLog, format, ap);
+	va_end(ap);
+}
+
+/* printf again with the stored arguments, one conversion at a time */
+static void
+traceformat(const TraceRecord *e, char *buf, size_t size)
+{
+	char spec[32];
+	const char *f, *start;
+	size_t n = 0, speclen;
+	int arg = 0, longs;
+	char conv;
+
+	buf[0] = '\0';
+	for (f = e->name; *f && n + 1 < size; f++) {
+		if (*f != '%') {
+			buf[n++] = *f;
+			buf[n] = '\0';
+			continue;
+		}
+		start = f++;
+		if (*f == '%') {
+			buf[n++] = '%';
+			buf[n] = '\0';
+			continue;
+		}
+		for (; *f && strchr("-+ #0123456789.", *f); f++);
+		for (longs = 0; *f && strchr("hlLqjzt", *f); f++)
+			longs += *f != 'h';
+		if (!*f)
+			break;
+		conv = *f;
+		speclen = MIN((size_t)(f - start + 1), sizeof(spec) - 1);
+		memcpy(spec, start, speclen);
+		spec[speclen] = '\0';
+		if (arg >= e->nargs) {
+			snprintf(buf + n, size - n, "?");
+		} else if (strchr("dic", conv)) {
+			if (longs)
+				snprintf(buf + n, size - n, spec, (long)e->args[arg].i);
+			else
+				snprintf(buf + n, size - n, spec, (int)e->args[arg].i);
+		} else if (strchr("uxXo", conv)) {
+			if (longs)
+				snprintf(buf + n, size - n, spec, (unsigned long)e->args[arg].i);
+			else
+				snprintf(buf + n, size - n, spec, (unsigned int)e->args[arg].i);
+		} else if (strchr("fFeEgGaA", conv)) {
+			snprintf(buf + n, size - n, spec, e->args[arg].f);
+		} else if (conv == 'p') {
+			snprintf(buf + n, size - n, "%p", (void *)(uintptr_t)e->args[arg].i);
+		} else if (conv == 's') {
+			snprintf(buf + n, size - n, spec,
+				e->args[arg].i < TRACE_STRLEN ? e->str + e->args[arg].i : "");
+		} else {
+			snprintf(buf + n, size - n, "%s", spec);
+			arg--;
+		}
+		arg++;
+		n += strlen(buf + n);
+	}
+}
+
+static void
+tracejsonstring(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char)*s < ' ')
+			fprintf(fp, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/* writes what is left in the ring, oldest first.  returns the number of
+ * events written or -1 */
+int
+tracedump(const char *path)
+{
+	FILE *fp;
+	const TraceRecord *e;
+	unsigned long head, i;
+	char text[512];
+	int fd, n = 0;
+	pid_t pid = getpid();
+
+	/* never through a link or over a file someone put there */
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600)) < 0)
+		return -1;
+	if (!(fp = fdopen(fd, "w"))) {
+		close(fd);
+		return -1;
+	}
+	head = __atomic_load_n(&tracehead, __ATOMIC_ACQUIRE);
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", fp);
+	for (i = head > TRACE_SIZE ? head - TRACE_SIZE : 0; i < head; i++) {
+		e = &tracering[i & (TRACE_SIZE - 1)];
+		/* still being written, or already overwritten by a newer one */
+		if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != i + 1)
+			continue;
+		if (e->ph == 'i')
+			traceformat(e, text, sizeof(text));
+		else
+			snprintf(text, sizeof(text), "%s", e->name ? e->name : "?");
+		fprintf(fp, "%s\n{\"name\":", n++ ? "," : "");
+		tracejsonstring(fp, text);
+		fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+			tracecatnames[e->cat], e->ph, e->ts / 1000.0, (int)pid, (int)pid);
+		if (e->ph == 'X')
+			fprintf(fp, ",\"dur\":%.3f", e->dur / 1000.0);
+		else
+			fputs(",\"s\":\"t\"", fp);
+		fputc('}', fp);
+	}
+	fputs("\n]}\n", fp);
+	if (fclose(fp) == EOF)
+		return -1;
+	return n;
+}
@@ -57,6 +57,9 @@ int dump_focused_title_change_event(yajl_gen gen, const int mon_num,
 
 int dump_client_state(yajl_gen gen, const ClientState *state);
 
+/* defined in metrics.c */
+int dump_stats(yajl_gen gen);
+
 int dump_focused_state_change_event(yajl_gen gen, const int mon_num,
                                     const Window client_id,
                                     const ClientState *old_state,